@@ -1,119 +1,405 @@
 #include "splashkit.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <new>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
-// increase the value of the input x by an ease out quint, until it reaches 1
-double ease_out_quint(double x)
+// frame tracing, the TRACE_ macros are compiled out unless the game is built with -DFTF_TRACE
+// each thread writes its zones into its own ring buffer, the buffers are read to export a chrome trace (chrome://tracing or ui.perfetto.dev)
+#ifdef FTF_TRACE
+// a zone that ran on a thread, times are ns since the recorder started
+struct trace_event_data
 {
-    return 1 - std::pow(1 - x, 5);
-}
+    const char *name;
+    long long start;
+    long long end;
+};
 
-// use to increase values by an ease function,
-struct ease_data
+// ring buffer of one thread's zones, only the owning thread writes so it needs no lock
+// readers check the write count again after copying and drop the events that may have been overwritten meanwhile
+struct trace_buffer_data
 {
-private:
-    double initial_value; // initial value of the variable (only used for ease_value without variable pointer)
-    double change_by;     // the amount the value needs to be change from initial to end
-    double increase;      // the amount the value has been increased by (x value of the ease function)
+    static const int CAPACITY = 1 << 16; // must be a power of 2
+
+    int thread_id;
+    vector<trace_event_data> events;
+    std::atomic<unsigned long long> written; // events ever written, the newest is at (written - 1) % CAPACITY
 
-    double calculate_ease(double time, double delta_time)
+    trace_buffer_data(int thread_id) : events(CAPACITY)
     {
-        int max_increase = 1; // increase should only go from 0 to 1
+        this->thread_id = thread_id;
+        written = 0;
+    }
 
-        double increment_rate = max_increase / (time / delta_time);
-        increase += increment_rate; // incrementing the increase by the rate
+    void push(const trace_event_data &event)
+    {
+        unsigned long long index = written.load(std::memory_order_relaxed);
+        events[index & (CAPACITY - 1)] = event;
+        written.store(index + 1, std::memory_order_release);
+    }
+};
 
-        if (increase >= max_increase)
+// collects the zones of every thread, exports them as chrome trace json and dumps the recent history when a frame goes over budget
+class trace_recorder_data
+{
+private:
+    std::chrono::steady_clock::time_point start_time;
+    std::mutex buffers_lock; // only taken when a thread writes its first zone and when exporting
+    vector<std::unique_ptr<trace_buffer_data>> buffers;
+
+    // flight recorder
+    double frame_budget;     // ms, 0 turns the flight recorder off
+    double history_seconds;  // how much history is dumped
+    long long frame_start;   // ns, -1 outside of a frame
+    long long last_dump;     // ns, -1 if there has not been a dump
+    int dump_count;
+
+    // copy the events that ended after since (ns) out of every buffer
+    vector<std::pair<int, trace_event_data>> collect(long long since)
+    {
+        std::lock_guard<std::mutex> guard(buffers_lock);
+        vector<std::pair<int, trace_event_data>> result;
+        for (int i = 0; i < buffers.size(); i++)
         {
-            increase = max_increase; // making sure increase does not go over 1
-        }
+            trace_buffer_data &buffer = *buffers[i];
+            unsigned long long written = buffer.written.load(std::memory_order_acquire);
+            unsigned long long first = written > trace_buffer_data::CAPACITY ? written - trace_buffer_data::CAPACITY : 0;
 
-        return ease_func(increase); // returning the ease function of the increase
+            vector<trace_event_data> copied;
+            for (unsigned long long j = first; j < written; j++)
+            {
+                copied.push_back(buffer.events[j & (trace_buffer_data::CAPACITY - 1)]);
+            }
+
+            // the owner kept writing while copying, the oldest copied events may be overwritten
+            // (one more is dropped for the event that may be half written)
+            unsigned long long written_after = buffer.written.load(std::memory_order_acquire) + 1;
+            unsigned long long valid = written_after > trace_buffer_data::CAPACITY ? written_after - trace_buffer_data::CAPACITY : 0;
+            for (unsigned long long j = std::max(first, valid); j < written; j++)
+            {
+                const trace_event_data &event = copied[j - first];
+                if (event.end >= since)
+                {
+                    result.push_back({buffer.thread_id, event});
+                }
+            }
+        }
+        return result;
     }
 
 public:
-    double value; // the value that is being eased (only used for ease_value without variable pointer) default is 0
-    // should be changed if the value to start increasing is not 0
-    // acts as a pointer to the variable that is being eased (syncs the value with the variable)
+    // Constructor
+    trace_recorder_data()
+    {
+        start_time = std::chrono::steady_clock::now();
+        frame_budget = 0;
+        history_seconds = 5;
+        frame_start = -1;
+        last_dump = -1;
+        dump_count = 0;
+    }
+
+    // get the recorder shared by every thread
+    static trace_recorder_data &get()
+    {
+        static trace_recorder_data recorder;
+        return recorder;
+    }
 
-    double time_to_ease;         // the time it takes for the value to ease to the end value (used when change_by is positive)
-    double time_to_release;      // the time it takes for the value to release to the initial value (used when change_by is negative)
-    double (*ease_func)(double); // the ease function to be used
+    // ns since the recorder started
+    long long now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
 
-    // Constructor
-    ease_data()
+    // get the calling thread's buffer, registering it on the thread's first zone
+    trace_buffer_data &get_thread_buffer()
+    {
+        thread_local trace_buffer_data *buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            std::lock_guard<std::mutex> guard(buffers_lock);
+            buffers.push_back(std::unique_ptr<trace_buffer_data>(new trace_buffer_data(buffers.size())));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    // dump the last history_seconds of zones whenever a frame takes longer than frame_budget ms (0 turns it off)
+    void set_flight_recorder(double frame_budget, double history_seconds)
     {
-        increase = 0;
-        change_by = 0;
-        initial_value = 0;
-        value = 0;             // default value is 0
-        time_to_ease = 800;    // default time to ease is 800 ms
-        time_to_release = 800; // default time to release is 800 ms
+        this->frame_budget = frame_budget;
+        this->history_seconds = history_seconds;
     }
 
-    // eases the value of the variable to the to_value directly (using pointers)
-    void ease_value(double *variable, double to_value, double delta_time)
+    // mark the start of a frame's work (the time waiting for the next frame should be outside of the frame)
+    void begin_frame()
     {
-        double time;
+        frame_start = now();
+    }
 
-        if (this->change_by != to_value - *variable)
+    // mark the end of a frame, records the frame as a zone and dumps the history if it went over budget
+    // dumps are at least history_seconds apart, so a slow patch is not dumped every frame
+    void end_frame()
+    {
+        if (frame_start < 0)
         {
-            increase = 0;
+            return;
         }
+        long long frame_end = now();
+        get_thread_buffer().push({"frame", frame_start, frame_end});
 
-        if (increase == 0)
+        long long history = (long long)(history_seconds * 1e9);
+        bool over_budget = frame_budget > 0 && frame_end - frame_start > frame_budget * 1e6;
+        if (over_budget && (last_dump < 0 || frame_end - last_dump >= history))
         {
-            initial_value = *variable;
-            change_by = to_value - *variable;
+            string path = "trace_spike_" + std::to_string(dump_count) + ".json";
+            export_chrome_trace(path, frame_end - history);
+            write_line("Frame took " + std::to_string((frame_end - frame_start) / 1e6) + " ms, trace saved to " + path);
+            last_dump = frame_end;
+            dump_count++;
         }
+        frame_start = -1;
+    }
+
+    // write the zones that ended after since (ns) to a chrome trace json file, returns false if the file could not be written
+    bool export_chrome_trace(const string &path, long long since = 0)
+    {
+        vector<std::pair<int, trace_event_data>> events = collect(since);
 
-        if (change_by < 0)
+        std::ofstream file(path);
+        if (!file)
         {
-            time = time_to_release;
+            return false;
         }
-        else if (change_by > 0)
+
+        file << std::fixed << std::setprecision(3); // chrome trace times are in microseconds
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        for (int i = 0; i < events.size(); i++)
         {
-            time = time_to_ease;
+            const trace_event_data &event = events[i].second;
+            file << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << events[i].first
+                 << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
         }
+        file << "\n]}\n";
+        return true;
+    }
+};
+
+// records the time from its construction to the end of the scope as a zone
+struct trace_zone_data
+{
+    const char *name;
+    long long start;
+
+    trace_zone_data(const char *name)
+    {
+        this->name = name;
+        start = trace_recorder_data::get().now();
+    }
 
-        double eased = calculate_ease(time, delta_time);
+    ~trace_zone_data()
+    {
+        trace_recorder_data &recorder = trace_recorder_data::get();
+        recorder.get_thread_buffer().push({name, start, recorder.now()});
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_ZONE(name) trace_zone_data TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_BEGIN_FRAME() trace_recorder_data::get().begin_frame()
+#define TRACE_END_FRAME() trace_recorder_data::get().end_frame()
+#define TRACE_FLIGHT_RECORDER(frame_budget, history_seconds) trace_recorder_data::get().set_flight_recorder(frame_budget, history_seconds)
+#define TRACE_EXPORT(path) trace_recorder_data::get().export_chrome_trace(path)
+#else
+#define TRACE_ZONE(name)
+#define TRACE_BEGIN_FRAME()
+#define TRACE_END_FRAME()
+#define TRACE_FLIGHT_RECORDER(frame_budget, history_seconds)
+#define TRACE_EXPORT(path)
+#endif
+
+// ease curves as types, so an ease is worked out by inlined code instead of a call through a function pointer
+// at(x) goes from 0 to 1 as x goes from 0 to 1, MAX_SECOND_DERIVATIVE bounds the error of a lookup table for the curve
+struct ease_out_quint_curve
+{
+    static constexpr double MAX_SECOND_DERIVATIVE = 20; // |f''(x)| = 20 * (1 - x)^3
 
-        *variable = initial_value + eased * change_by;
+    static constexpr double at(double x)
+    {
+        double y = 1 - x;
+        return 1 - y * y * y * y * y;
     }
+};
+
+// the values of a curve at size + 1 evenly spaced points from 0 to 1, worked out when compiling
+template <int size>
+struct ease_table_values_data
+{
+    double values[size + 1];
+};
 
-    // returns the eased value of the initial value to the to_value
-    double ease_value(double to_value, double delta_time)
+template <typename curve, int size>
+constexpr ease_table_values_data<size> make_ease_table_values()
+{
+    ease_table_values_data<size> table = {};
+    for (int i = 0; i <= size; i++)
     {
-        double time;
+        table.values[i] = curve::at((double)i / size);
+    }
+    return table;
+}
+
+// a curve looked up from a table made when compiling, linearly interpolated between the points
+// used like the curve itself, for curves that are slower to work out than a lookup (the error is at most ERROR_BOUND)
+template <typename curve, int size>
+struct ease_table_data
+{
+    static constexpr ease_table_values_data<size> TABLE = make_ease_table_values<curve, size>();
+    static constexpr double ERROR_BOUND = curve::MAX_SECOND_DERIVATIVE / (8.0 * size * size); // linear interpolation error, h^2 / 8 * max|f''|
+    static constexpr double MAX_SECOND_DERIVATIVE = curve::MAX_SECOND_DERIVATIVE;
 
-        if (this->change_by != to_value - value)
+    static constexpr double at(double x)
+    {
+        if (x <= 0)
         {
-            increase = 0;
+            return TABLE.values[0];
         }
+        if (x >= 1)
+        {
+            return TABLE.values[size];
+        }
+
+        double position = x * size;
+        int index = (int)position;
+        double weight = position - index;
+        return TABLE.values[index] + (TABLE.values[index + 1] - TABLE.values[index]) * weight;
+    }
+};
+
+// handle of a tween in a tween scheduler
+typedef int tween_handle;
+
+// eases values towards their targets over time, every tween is kept in one pool and the moving ones are updated in one pass
+// a tween starts moving when its target changes and is retired once it gets there, tweens at rest are not updated at all
+// curve is an ease curve type, or an ease_table_data of one for curves that are slower to work out than a lookup
+template <typename curve>
+class basic_tween_scheduler_data
+{
+private:
+    struct tween_data
+    {
+        double value;
+        double start_value;     // the value when the target last changed
+        double to_value;        // the target
+        double progress;        // 0 to 1, the x value of the ease curve
+        double time_to_ease;    // ms, used when the value goes up
+        double time_to_release; // ms, used when the value goes down
+        int active_index;       // index in active, -1 when the tween is at rest
+    };
+
+    vector<tween_data> tweens;   // indexed by handle
+    vector<tween_handle> active; // the tweens moving towards their targets
+
+    // stop updating a tween, moving the last active tween into its place
+    void retire(tween_handle handle)
+    {
+        int index = tweens[handle].active_index;
+        active[index] = active.back();
+        tweens[active[index]].active_index = index;
+        active.pop_back();
+        tweens[handle].active_index = -1;
+    }
+
+public:
+    // add a tween at rest at value, returns its handle
+    tween_handle add(double value, double time_to_ease = 800, double time_to_release = 800)
+    {
+        tweens.push_back({value, value, value, 1, time_to_ease, time_to_release, -1});
+        return tweens.size() - 1;
+    }
 
-        if (increase == 0)
+    // start easing a tween towards to_value, from the value it has now (nothing changes if that is already its target)
+    void ease_to(tween_handle handle, double to_value)
+    {
+        tween_data &tween = tweens[handle];
+        if (to_value == tween.to_value)
         {
-            this->initial_value = value;
-            change_by = to_value - value;
+            return;
         }
 
-        if (change_by < 0)
+        tween.start_value = tween.value;
+        tween.to_value = to_value;
+        tween.progress = 0;
+        if (tween.active_index == -1)
         {
-            time = time_to_release;
+            tween.active_index = active.size();
+            active.push_back(handle);
         }
-        else if (change_by > 0)
+    }
+
+    // move a tween to a value straight away
+    void set_value(tween_handle handle, double value)
+    {
+        tweens[handle].value = value;
+        tweens[handle].to_value = value;
+        if (tweens[handle].active_index != -1)
         {
-            time = time_to_ease;
+            retire(handle);
         }
+    }
 
-        double eased = calculate_ease(time, delta_time);
+    // move every active tween along its curve by delta_time (ms), retiring the ones that reach their target
+    void update(double delta_time)
+    {
+        int i = 0;
+        while (i < active.size())
+        {
+            tween_data &tween = tweens[active[i]];
+            double time = tween.to_value < tween.start_value ? tween.time_to_release : tween.time_to_ease;
+            tween.progress = time > 0 ? std::min(1.0, tween.progress + delta_time / time) : 1;
 
-        value = initial_value + eased * change_by;
+            if (tween.progress >= 1)
+            {
+                tween.value = tween.to_value;
+                retire(active[i]); // the last active tween is moved to i, so i is not moved on
+            }
+            else
+            {
+                tween.value = tween.start_value + curve::at(tween.progress) * (tween.to_value - tween.start_value);
+                i++;
+            }
+        }
+    }
 
-        return value;
+    double get_value(tween_handle handle) const
+    {
+        return tweens[handle].value;
     }
 };
 
+// the tweens used by the game's effects
+typedef basic_tween_scheduler_data<ease_out_quint_curve> tween_scheduler_data;
+
 // data type for coorindates, can be used for both pixel and tile coordinates
 // tile coordinates are the coordinates of the tiles in the room (room_data)
 struct coordinate
@@ -121,13 +407,13 @@ struct coordinate
     double x, y;
 
     // to convert tile coorindates to pixel coordinates
-    coordinate tile_to_pixel(double tile_size)
+    coordinate tile_to_pixel(double tile_size) const
     {
         return {x * tile_size, y * tile_size};
     }
 
     // to convert pixel coordinates to tile coordinates of the room
-    coordinate pixel_to_tile(double tile_size)
+    coordinate pixel_to_tile(double tile_size) const
     {
         double pixel_x = ceil(x / tile_size) - 1;
         double pixel_y = ceil(y / tile_size) - 1;
@@ -135,1974 +421,5919 @@ struct coordinate
     }
 };
 
-// generate random coordinates
-coordinate random_coordinate(const coordinate &max_coords)
-{
-    return {(double)rnd(max_coords.x), (double)rnd(max_coords.y)};
-}
-
-coordinate random_coordinate(const coordinate &min_coords, const coordinate &max_coords)
-{
-    return {(double)rnd(min_coords.x, max_coords.x), (double)rnd(min_coords.y, max_coords.y)};
-}
-
-// make a game size struct
-class game_size_data
+// small random number stream (xoshiro256**), each stream gives the same numbers for the same seed on any thread
+// the simulation takes all its random numbers from streams, so a seed replays the same game with or without a window
+// a seed can have many streams (one per entity, chunk or thread), each starts at a state picked by splitmix64 from the seed and stream number
+// so two streams are unlikely to run into the same stretch of numbers in a game's length, but nothing (like xoshiro's jump) rules it out
+struct random_stream_data
 {
-private:
-    int screen_height; // the height of the screen
-    int screen_width;  // the width of the screen
-    int room_width;    // the number of tiles in the room on the x axis
-    int room_height;   // the number of tiles in the room on the y axis
-    double zoom_level; // the zoom level of the game or screen
+    unsigned long long state[4];
 
-public:
-    // Constructor
-    game_size_data(int screen_width, int screen_height, int room_width, int room_height)
+    // splitmix64, spreads a seed over the state so similar seeds give unrelated streams
+    static unsigned long long mix(unsigned long long &value)
     {
-        this->screen_height = screen_height;
-        this->screen_width = screen_width;
-        this->room_width = room_width;
-        this->room_height = room_height;
-        this->zoom_level = 1;
+        value += 0x9E3779B97F4A7C15ULL;
+        unsigned long long z = value;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
     }
 
-    game_size_data() : game_size_data(1080, 1920, 40, 30) {}
-
-    // getters and setters
-    int get_screen_height() const
-    {
-        return screen_height;
-    }
-    // screen width is calculated using the screen height and the room width and height
-    int get_screen_width() const
+    static unsigned long long rotate_left(unsigned long long value, int bits)
     {
-        return screen_width;
+        return (value << bits) | (value >> (64 - bits));
     }
 
-    int get_room_width() const
+    // Constructor, stream picks one of the seed's streams
+    random_stream_data(unsigned long long seed = 0, unsigned long long stream = 0)
     {
-        return room_width;
+        unsigned long long stream_key = stream;
+        unsigned long long value = seed ^ mix(stream_key);
+        for (int i = 0; i < 4; i++)
+        {
+            state[i] = mix(value);
+        }
     }
 
-    int get_room_height() const
+    unsigned long long next()
     {
-        return room_height;
+        unsigned long long result = rotate_left(state[1] * 5, 7) * 9;
+        unsigned long long t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate_left(state[3], 45);
+        return result;
     }
 
-    double get_zoom_level() const
+    // random int from 0 to bound - 1, every int is equally likely (multiply and reject the few values that would favour the low ints)
+    int next_int(int bound)
     {
-        return zoom_level;
+        if (bound <= 0)
+            return 0;
+        unsigned long long range = (unsigned long long)bound;
+        unsigned long long product = (next() >> 32) * range;
+        if ((product & 0xFFFFFFFFULL) < range)
+        {
+            unsigned long long threshold = (0x100000000ULL - range) % range;
+            while ((product & 0xFFFFFFFFULL) < threshold)
+            {
+                product = (next() >> 32) * range;
+            }
+        }
+        return (int)(product >> 32);
     }
 
-    // set the zoom level of the game
-    void set_zoom_level(double zoom_level)
+    // random int from low to high - 1
+    int next_int(int low, int high)
     {
-        this->zoom_level = zoom_level;
+        return low + next_int(high - low);
     }
 
-    void set_zoom_level(double zoom_level, ease_data &ease, double delta_time)
+    // random double from 0 up to (not including) 1, from the top 53 bits
+    double next_double()
     {
-        ease.ease_value(&this->zoom_level, zoom_level, delta_time);
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
     }
 
-    // get the camera position that would keep the parameter coorindate in the center of the screen
-    coordinate get_camera_position(coordinate center_position) const
+    // random double from low up to (not including) high
+    double next_double(double low, double high)
     {
-        return {center_position.x - (get_screen_width() / 2), center_position.y - (screen_height / 2)};
+        return low + (high - low) * next_double();
     }
 };
 
-// class to hold the timing data of the game (mostly for the delta time)
-class game_timing_data
+// mix a value into a hash of the simulation's state, any change to a value changes the hash
+unsigned long long hash_state(unsigned long long hash, unsigned long long value)
 {
-private:
-    double delta_time;             // time between the last frame and the current frame
-    double time_rate;              // how many seconds the game should load in one second
-    double time_difference;        // delta time wihtout the time rate
-    double last_update_time;       // the time of the last frame
-    int frame_rate;                // the frame rate of the game
-    double last_frame_update_time; // the time of the last frame update
+    unsigned long long mixed = hash ^ value;
+    return random_stream_data::mix(mixed);
+}
 
-    // get the time it takes for each frame to be displayed to fit frame rate
-    double get_frame_delay() const
-    {
-        return 1000 / frame_rate;
-    }
+// doubles are mixed by their bits, so even the smallest difference in a position shows
+unsigned long long hash_state(unsigned long long hash, double value)
+{
+    unsigned long long bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return hash_state(hash, bits);
+}
 
-public:
-    // Constructor
-    game_timing_data()
-    {
-        delta_time = 0;
-        time_rate = 1;
-        time_difference = 0;
-        last_update_time = 0;
-        frame_rate = 60;
-        last_frame_update_time = 0;
-    }
 
-    game_timing_data(int frame_rate)
+// work-stealing job system with a fixed pool of worker threads
+// each thread has its own queue of jobs, takes jobs from the back of its own queue and steals from the front of the others when it runs out
+class job_system_data
+{
+private:
+    struct job_queue_data
     {
-        delta_time = 0;
-        time_rate = 1;
-        time_difference = 0;
-        last_update_time = 0;
-        last_frame_update_time = 0;
-        this->frame_rate = frame_rate;
-    }
-
-    // must be ran inside a game loop in order to update the delta time
-    void update_timing()
+        std::mutex lock;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    vector<std::unique_ptr<job_queue_data>> queues; // queue 0 belongs to the thread calling parallel_for, the others to the workers
+    vector<std::thread> workers;
+    std::atomic<int> queued_jobs; // jobs that have not been started, workers sleep while there are none
+    std::atomic<bool> stopping;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    // take a job from the back of a thread's own queue, or steal one from the front of another queue
+    bool find_job(int queue_index, std::function<void()> &job)
     {
-        time_difference = (double)timer_ticks("Main timer") - (double)last_update_time; // getting delta_time
-        last_update_time = (double)timer_ticks("Main timer");                           // setting the last update time
-        last_frame_update_time += time_difference;                                      // adding the delta time to the last frame update time
-        delta_time = time_difference * time_rate;                                       // changing the delta time according to the time rate
-    }
+        {
+            job_queue_data &own = *queues[queue_index];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.jobs.empty())
+            {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+                queued_jobs--;
+                return true;
+            }
+        }
 
-    // setters and getters
-    double get_delta_time() const
-    {
-        return delta_time;
+        for (int i = 1; i < queues.size(); i++)
+        {
+            job_queue_data &other = *queues[(queue_index + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(other.lock);
+            if (!other.jobs.empty())
+            {
+                job = std::move(other.jobs.front());
+                other.jobs.pop_front();
+                queued_jobs--;
+                return true;
+            }
+        }
+
+        return false;
     }
 
-    double get_time_difference() const
+    void worker_loop(int queue_index)
     {
-        return time_difference;
+        std::function<void()> job;
+        while (!stopping)
+        {
+            if (find_job(queue_index, job))
+            {
+                job();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this]
+                      { return queued_jobs > 0 || stopping; });
+        }
     }
 
-    // set time rate, changes the time rate of the delta time
-    void set_time_rate(double rate)
+public:
+    // Constructor, thread_count includes the thread calling parallel_for (defaults to the number of hardware threads)
+    job_system_data(int thread_count = std::thread::hardware_concurrency())
     {
-        time_rate = rate;
+        thread_count = std::max(1, thread_count);
+        queued_jobs = 0;
+        stopping = false;
+
+        for (int i = 0; i < thread_count; i++)
+        {
+            queues.push_back(std::unique_ptr<job_queue_data>(new job_queue_data()));
+        }
+        for (int i = 1; i < thread_count; i++)
+        {
+            workers.push_back(std::thread(&job_system_data::worker_loop, this, i));
+        }
     }
 
-    void set_time_rate(double time_rate, ease_data &ease, double delta_time)
+    job_system_data(const job_system_data &) = delete;
+    job_system_data &operator=(const job_system_data &) = delete;
+
+    // Destructor, stops the worker threads
+    ~job_system_data()
     {
-        ease.ease_value(&this->time_rate, time_rate, delta_time);
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (int i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
     }
 
-    // set frame rate, changes the frame rate of the game, tells when the game should update the frame (calling screen_refresh)
-    bool update_frame()
+    // run job(0) to job(job_count - 1) on the pool, the calling thread helps and the function returns once every job has finished
+    // jobs can run in any order and on any thread, so they must only write to data no other job uses
+    void parallel_for(int job_count, const std::function<void(int)> &job)
     {
-        if (last_frame_update_time >= get_frame_delay())
+        std::atomic<int> remaining(job_count);
+
+        // spreading the jobs over the queues, the workers steal from each other if they are uneven
+        for (int i = 0; i < job_count; i++)
         {
-            last_frame_update_time = 0;
-            return true;
+            job_queue_data &queue = *queues[i % queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.jobs.push_back([&job, &remaining, i]
+                                 {
+                                     job(i);
+                                     remaining--; });
+            queued_jobs++;
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+        }
+        wake.notify_all();
+
+        std::function<void()> next_job;
+        while (remaining > 0)
+        {
+            if (find_job(0, next_job))
+                next_job();
+            else
+                std::this_thread::yield();
         }
-        return false;
-        // true if the game is ready to update the frame, false if not
     }
 };
 
-// floor tile struct
-struct tile_data
+
+// handle of a sprite in the sprite registry, -1 if there is no sprite
+typedef int sprite_handle;
+
+// an image and what is needed to draw it, kept so the game never has to look up a name or ask SplashKit for its size
+struct sprite_data
 {
-    color tile_color;
-    bool passable;
-    int size;
-    rectangle tile;
+    sprite_handle handle;
+    bitmap model;             // nullptr when running headless
+    bitmap texture;           // the bitmap the sprite is drawn from, the sprite atlas or the model when it is not in the atlas
+    rectangle part;           // where the sprite is in the texture
+    double width, height;     // pixels
+    double pivot_x, pivot_y;  // SplashKit scales bitmaps around their center, drawn positions are corrected by pivot * (scale - 1)
+    double smallest_side;     // pixels, models are sized by their smallest side
+
+    // get the scaling that makes the smallest side of the sprite size pixels long
+    double get_scaling(double size) const
+    {
+        return size / smallest_side;
+    }
 };
 
-// flooring struct, using tiles as arrays
-class room_data
+// every image under a folder, found by handle
+// the images are indexed first (name, path and size, read from the sprite pack or the png headers) and their bitmaps are loaded with SplashKit later,
+// so the game can be set up before any image is decoded, and headless runs never decode one
+class sprite_registry_data
 {
 private:
-    vector<vector<tile_data>> floor_array; // the floor of the room
-
-    // contains the start and end tile coordinates of the walls
-    // elements are coordinate vectors of two elements, the first element is the start tile, the second element is the end tiles
-    vector<vector<coordinate>> walls_coords_vector;
-
-    vector<rectangle> walls_vector; // rectangles of the walls, can work as hitboxes of walls
-    color color_pattern[3];         // 0 and 1 is the floor checkers color pattern, 2 is the walls
-    int size_y;                     // room height
-    int size_x;                     // room width
-    double tile_size;               // size of each tile
-    coordinate spawn_coords;
+    bool headless;
+    vector<sprite_data> sprites;                          // indexed by handle
+    vector<string> names;                                 // indexed by handle
+    vector<string> paths;                                 // the png file of each sprite, indexed by handle
+    std::unordered_map<string, sprite_handle> handles; // only used when finding a handle by name
+    bitmap atlas;                                         // the small sprites packed into one bitmap, nullptr until it is built
 
-    double zoom_level;       // zoom level of the room
-    double zoomed_tile_size; // size of each tile after zooming
+    static constexpr char PACK_MAGIC[8] = {'F', 'T', 'F', 'P', 'A', 'C', 'K', '1'};
 
-    // a function to construct the room, used in the constructor
-    void construct_room(int room_width, int room_height, int screen_width, int screen_height, const color &floor_color_1, const color &floor_color_2, const color &wall_color, const coordinate &spawn_tile)
+    // read the size from a png file's header (the IHDR chunk always comes first)
+    static bool read_png_size(const string &path, double &width, double &height)
     {
-        color_pattern[0] = floor_color_1;
-        color_pattern[1] = floor_color_2;
-        color_pattern[2] = wall_color;
-        this->size_x = room_width;
-        this->size_y = room_height;
-        this->zoom_level = 1;
-
-        double size1 = (double)screen_width / (double)room_width;
-        double size2 = (double)screen_height / (double)room_height;
-        if (size1 >= size2)
-            this->tile_size = size1;
-        else
-            this->tile_size = size2;
+        std::ifstream file(path, std::ios::binary);
+        unsigned char header[24];
+        if (!file.read((char *)header, sizeof(header)) || header[1] != 'P' || header[2] != 'N' || header[3] != 'G')
+        {
+            return false;
+        }
 
-        this->spawn_coords = spawn_tile;
+        width = ((unsigned int)header[16] << 24) | ((unsigned int)header[17] << 16) | ((unsigned int)header[18] << 8) | (unsigned int)header[19];
+        height = ((unsigned int)header[20] << 24) | ((unsigned int)header[21] << 16) | ((unsigned int)header[22] << 8) | (unsigned int)header[23];
+        return true;
+    }
 
-        // update the zoomed tile size (using tile_size and zoom_level)
-        update_zoomed_tile_size();
+    // numbers and strings in the sprite pack are little endian, strings have their length first
+    static void write_pack_number(std::ofstream &file, unsigned int number)
+    {
+        unsigned char bytes[4] = {(unsigned char)number, (unsigned char)(number >> 8), (unsigned char)(number >> 16), (unsigned char)(number >> 24)};
+        file.write((const char *)bytes, sizeof(bytes));
+    }
 
-        // setting spawn coordinates, it is passed as a tile coordinate
-        this->spawn_coords = this->spawn_coords.tile_to_pixel(zoomed_tile_size);
+    static bool read_pack_number(std::ifstream &file, unsigned int &number)
+    {
+        unsigned char bytes[4];
+        if (!file.read((char *)bytes, sizeof(bytes)))
+        {
+            return false;
+        }
+        number = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+        return true;
+    }
 
-        // setting the wall (surronding the room)
-        set_wall({0, 0}, {(double)(size_x - 1), 0});                                       // top wall
-        set_wall({0, 1}, {0, (double)(size_y - 2)});                                       // left wall
-        set_wall({(double)(size_x - 1), 1}, {(double)(size_x - 1), (double)(size_y - 2)}); // right wall
-        set_wall({0, (double)(size_y - 1)}, {(double)(size_x - 1), (double)(size_y - 1)}); // bottom wall
+    static void write_pack_string(std::ofstream &file, const string &text)
+    {
+        write_pack_number(file, text.size());
+        file.write(text.data(), text.size());
+    }
 
-        // initializing the floor 2d vector
-        floor_array = vector<vector<tile_data>>(size_y, vector<tile_data>(size_x));
+    static bool read_pack_string(std::ifstream &file, string &text)
+    {
+        const unsigned int MAX_LENGTH = 4096;
 
-        build_room();
+        unsigned int length;
+        if (!read_pack_number(file, length) || length > MAX_LENGTH)
+        {
+            return false;
+        }
+        text.resize(length);
+        return (bool)file.read(&text[0], length);
     }
 
-    // function to update the zoomed tile size (depending if zoom level is changed)
-    void update_zoomed_tile_size()
+public:
+    // Constructor, headless sprites never have a bitmap
+    sprite_registry_data(bool headless)
     {
-        zoomed_tile_size = tile_size * zoom_level;
+        this->headless = headless;
+        atlas = nullptr;
     }
 
-    // build the floor of the room (setting floor_array with tiles)
-    void build_floor()
+    // add an image under a name without loading it, returns its handle or -1 if the name is taken
+    sprite_handle add(const string &name, const string &path, double width, double height)
     {
-        for (int y = 0; y < size_y; y++)
+        if (handles.count(name) > 0 || width <= 0 || height <= 0)
         {
-            for (int x = 0; x < size_x; x++)
-            {
-                floor_array[y][x].passable = true;
-                floor_array[y][x].size = zoomed_tile_size;
-
-                coordinate tile_coords = {(double)x, (double)y};
-                coordinate coords = tile_coords.tile_to_pixel(zoomed_tile_size);
+            return -1;
+        }
 
-                // setting the tile's position and size (rectangle objects)
-                floor_array[y][x].tile = {coords.x, coords.y, zoomed_tile_size, zoomed_tile_size};
+        sprite_data sprite = {(sprite_handle)sprites.size(), nullptr, nullptr, {0, 0, width, height}, width, height, width / 2, height / 2, std::min(width, height)};
+        sprites.push_back(sprite);
+        names.push_back(name);
+        paths.push_back(path);
+        handles[name] = sprite.handle;
+        return sprite.handle;
+    }
 
-                // making the floor as a checked pattern (setting colors for each tile)
-                color first_color = color_pattern[0];
-                color second_color = color_pattern[1];
-                if (y % 2 != 0)
-                {
-                    first_color = color_pattern[1];
-                    second_color = color_pattern[0];
-                }
+    // add every png under a folder (and its folders), named by the file name without the extension
+    // the files are added in path order so the handles are the same on every run, returns the number added
+    int add_folder(const string &folder)
+    {
+        vector<string> png_paths;
+        std::error_code error;
+        for (std::filesystem::recursive_directory_iterator it(folder, error), end; !error && it != end; it.increment(error))
+        {
+            if (it->is_regular_file() && it->path().extension() == ".png")
+            {
+                png_paths.push_back(it->path().string());
+            }
+        }
+        std::sort(png_paths.begin(), png_paths.end());
 
-                if (x % 2 == 0)
-                    floor_array[y][x].tile_color = first_color;
-                else
-                    floor_array[y][x].tile_color = second_color;
+        int added = 0;
+        for (int i = 0; i < png_paths.size(); i++)
+        {
+            double width = 0, height = 0;
+            if (read_png_size(png_paths[i], width, height) && add(std::filesystem::path(png_paths[i]).stem().string(), png_paths[i], width, height) != -1)
+            {
+                added++;
             }
         }
+        return added;
     }
 
-    // set the walls of the room, updating the floor_array with the walls
-    void build_wall()
+    // write the name, path and size of every added image to a sprite pack, so the next run can add them all from one small file
+    bool write_pack(const string &pack_path) const
     {
-        // creating the walls vector (rectangles) from the walls coordinates vector
-        walls_vector.clear(); // clearing the walls vector to update it with the new walls (walls can change depending on zoom_level)
-        for (int i = 0; i < walls_coords_vector.size(); i++)
+        std::ofstream file(pack_path, std::ios::binary);
+        file.write(PACK_MAGIC, sizeof(PACK_MAGIC));
+        write_pack_number(file, sprites.size());
+        for (int i = 0; i < sprites.size(); i++)
         {
-            // walls_coords_vector contains vectors contains a 2-element array with the start and end tile coordinates of the walls
-            coordinate wall_coords_start = walls_coords_vector[i][0].tile_to_pixel(zoomed_tile_size);
-            coordinate wall_coords_end = walls_coords_vector[i][1].tile_to_pixel(zoomed_tile_size);
+            write_pack_string(file, names[i]);
+            write_pack_string(file, paths[i]);
+            write_pack_number(file, sprites[i].width);
+            write_pack_number(file, sprites[i].height);
+        }
+        return (bool)file;
+    }
 
-            // adding the size of the tile to the end tile to get the bottom right corner of the wall
-            wall_coords_end.x += zoomed_tile_size;
-            wall_coords_end.y += zoomed_tile_size;
+    // add every image in a sprite pack, in the order they were packed, returns false (adding nothing) if there is no pack, it is not a sprite pack
+    // or it is stale: an image in it is missing or newer than the pack, or a file was added to or removed from the folders it packed after it was written
+    bool add_pack(const string &pack_path)
+    {
+        struct packed_image_data
+        {
+            string name, path;
+            unsigned int width, height;
+        };
 
-            // calculate the width and height of the wall
-            double wall_width = wall_coords_end.x - wall_coords_start.x;
-            double wall_height = wall_coords_end.y - wall_coords_start.y;
+        std::ifstream file(pack_path, std::ios::binary);
+        char magic[sizeof(PACK_MAGIC)];
+        unsigned int count;
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), PACK_MAGIC) || !read_pack_number(file, count))
+        {
+            return false;
+        }
 
-            // add the wall to the walls vector (a rectangle object)
-            walls_vector.push_back({wall_coords_start.x, wall_coords_start.y, wall_width, wall_height});
-            // the rectangle is from the top left corner of the start tile to the bottom right corner of the end tile
+        // only the files' times are checked, the pngs are not opened
+        std::error_code error;
+        auto pack_time = std::filesystem::last_write_time(pack_path, error);
+        auto is_newer_than_pack = [&pack_time](const std::filesystem::path &path)
+        {
+            std::error_code error;
+            auto time = std::filesystem::last_write_time(path, error);
+            return error || time > pack_time;
+        };
+        if (error || is_newer_than_pack(std::filesystem::path(pack_path).parent_path()))
+        {
+            return false;
         }
 
-        // using the walls_vector to update the floor_array with the walls
-        for (int y = 0; y < size_y; y++)
+        vector<packed_image_data> images;
+        for (unsigned int i = 0; i < count; i++)
         {
-            for (int x = 0; x < size_x; x++)
+            packed_image_data image;
+            if (!read_pack_string(file, image.name) || !read_pack_string(file, image.path) || !read_pack_number(file, image.width) || !read_pack_number(file, image.height))
             {
-                for (int i = 0; i < walls_vector.size(); i++)
-                {
-                    // any tiles in the floor_array that intersects with the walls_vector will be set as a wall
-                    if (rectangles_intersect(floor_array[y][x].tile, walls_vector[i]))
-                    {
-
-                        // Splashkit's rectangle_intersection counds touching as a collision, we ignore touching as collision
-                        rectangle intersection_box = intersection(floor_array[y][x].tile, walls_vector[i]);
-                        if (intersection_box.width > 0 && intersection_box.height > 0)
-                        {
-                            // tiles are walls if they are a wall color (color_pattern[2]) and are not passable
-                            floor_array[y][x].tile_color = color_pattern[2];
-                            floor_array[y][x].passable = false;
-                            break;
-                        }
-                    }
-                }
+                return false;
+            }
+            if (is_newer_than_pack(image.path) || is_newer_than_pack(std::filesystem::path(image.path).parent_path()))
+            {
+                return false;
             }
+            images.push_back(image);
         }
-    }
-
-public:
-    // Constructor
-    room_data(int floor_width, int floor_height, int screen_width, int screen_height)
-    {
-        // setting room color
-        color slate_grey = rgb_color(112, 128, 144);
-        color light_slate_grey = rgb_color(132, 144, 153);
-        color light_steel_blue = rgb_color(150, 170, 200);
 
-        construct_room(floor_width, floor_height, screen_width, screen_height, slate_grey, light_slate_grey, light_steel_blue, {(double)(floor_width - 1) / 2, (double)(floor_height - 1) - 2});
+        for (const packed_image_data &image : images)
+        {
+            add(image.name, image.path, image.width, image.height);
+        }
+        return true;
     }
 
-    room_data(int floor_width, int floor_height, int screen_width, int screen_height, const coordinate &spawn_coords)
+    // load the bitmaps of the added images with no side longer than max_side, returns false if one could not be loaded
+    // an image has to be the size it was added with (add_pack ignores a pack older than its images)
+    bool load_bitmaps(double max_side = HUGE_VAL)
     {
-        // setting room color
-        color slate_grey = rgb_color(112, 128, 144);
-        color light_slate_grey = rgb_color(132, 144, 153);
-        color light_steel_blue = rgb_color(150, 170, 200);
+        if (headless)
+        {
+            return true;
+        }
 
-        construct_room(floor_width, floor_height, screen_width, screen_height, slate_grey, light_slate_grey, light_steel_blue, spawn_coords);
-    }
+        for (int i = 0; i < sprites.size(); i++)
+        {
+            sprite_data &sprite = sprites[i];
+            if (sprite.model != nullptr || sprite.width > max_side || sprite.height > max_side)
+            {
+                continue;
+            }
 
-    room_data(int floor_width, int floor_height, int screen_width, int screen_height, const color &floor_color_1, const color &floor_color_2, const color &wall_color, const coordinate &spawn_coords)
-    {
-        construct_room(floor_width, floor_height, screen_width, screen_height, floor_color_1, floor_color_2, wall_color, spawn_coords);
+            bitmap model = load_bitmap(names[i], paths[i]);
+            if (!bitmap_valid(model) || bitmap_width(model) != sprite.width || bitmap_height(model) != sprite.height)
+            {
+                return false;
+            }
+            sprite.model = model;
+            sprite.texture = model;
+        }
+        return true;
     }
 
-    // building the room, setting the floor and walls, used when new walls are created (must be called in game loop to watch for changes in zoom_level)
-    void build_room()
+    // pack the loaded sprites with no side longer than max_side into one atlas bitmap, atlas_width pixels wide, returns the number packed
+    // sprites are placed left to right in rows, with a pixel of space around each so scaled sprites do not pick up their neighbours
+    // must be called before the sprites are handed out, bigger sprites (like the vignette) stay in their own bitmap
+    int build_atlas(int atlas_width, int max_side)
     {
-        // changing the zoomed_tile_size with updated zoom_level
-        update_zoomed_tile_size();
-
-        // building the floor
-        build_floor();
+        const int PADDING = 1;
 
-        // building the walls
-        build_wall();
-    }
+        if (headless || atlas != nullptr)
+        {
+            return 0;
+        }
 
-    // draw the room onto the screen
-    void draw() const
-    {
-        for (int y = 0; y < size_y; y++)
+        // placing the sprites in rows
+        vector<int> packed;
+        double row_x = PADDING, row_y = PADDING, row_height = 0;
+        for (int i = 0; i < sprites.size(); i++)
         {
-            for (int x = 0; x < size_x; x++)
+            sprite_data &sprite = sprites[i];
+            if (sprite.model == nullptr || sprite.width > max_side || sprite.height > max_side || sprite.width + 2 * PADDING > atlas_width)
             {
-                tile_data tile = floor_array[y][x];
+                continue;
+            }
 
-                fill_rectangle(tile.tile_color, tile.tile);
+            if (row_x + sprite.width + PADDING > atlas_width)
+            {
+                row_x = PADDING;
+                row_y += row_height + PADDING;
+                row_height = 0;
             }
+            sprite.part = {row_x, row_y, sprite.width, sprite.height};
+            row_x += sprite.width + PADDING;
+            row_height = std::max(row_height, sprite.height);
+            packed.push_back(i);
+        }
+
+        if (packed.empty())
+        {
+            return 0;
+        }
+
+        // copying the sprites into the atlas
+        atlas = create_bitmap("sprite_atlas", atlas_width, (int)(row_y + row_height + PADDING));
+        clear_bitmap(atlas, color_transparent());
+        for (int i : packed)
+        {
+            sprite_data &sprite = sprites[i];
+            draw_bitmap_on_bitmap(atlas, sprite.model, sprite.part.x, sprite.part.y);
+            sprite.texture = atlas;
         }
+        return packed.size();
     }
 
-    // check if a tile coords is passable
-    bool is_passable(const coordinate &tile_coords) const
+    // find the handle of an image by name, -1 if there is none (look handles up once, not while updating or drawing)
+    sprite_handle find(const string &name) const
     {
-        return floor_array[(int)tile_coords.y][(int)tile_coords.x].passable;
+        auto it = handles.find(name);
+        return it == handles.end() ? -1 : it->second;
     }
 
-    // getters and setters
-    const coordinate &get_spawn_coords() const
+    // get an image by handle, its model is nullptr until its bitmap is loaded
+    const sprite_data &get(sprite_handle handle) const
     {
-        return spawn_coords;
+        return sprites[handle];
     }
+};
 
-    int get_size_x() const
+// a sprite queued to be drawn, the position is where the unscaled sprite would be drawn (top left corner)
+struct sprite_quad_data
+{
+    const sprite_data *sprite;
+    double x, y;
+    double scaling;
+    bool flip;
+};
+
+// collects the sprites drawn in a frame and draws them all at once, in the order they were added
+// sprites in the atlas are all drawn from the same texture, so the renderer can send them to the gpu together instead of switching textures between sprites
+class sprite_batch_data
+{
+private:
+    vector<sprite_quad_data> quads;
+
+    // counted over every submit, used to report the draw calls per frame
+    int frame_count;
+    long long quad_count;
+    long long texture_batch_count;  // runs of sprites drawn from the same texture
+    long long separate_batch_count; // runs of sprites drawn from the same bitmap, the batches there would be without the atlas
+
+public:
+    // Constructor
+    sprite_batch_data()
     {
-        return size_x;
+        frame_count = 0;
+        quad_count = 0;
+        texture_batch_count = 0;
+        separate_batch_count = 0;
     }
 
-    int get_size_y() const
+    // queue a sprite, scaled by scaling and flipped when flip is true, x and y are the top left corner of the unscaled sprite
+    void add(const sprite_data &sprite, double x, double y, double scaling, bool flip)
     {
-        return size_y;
+        quads.push_back({&sprite, x, y, scaling, flip});
     }
 
-    double get_zoomed_tile_size() const
+    // draw every queued sprite and empty the queue
+    void submit()
     {
-        return zoomed_tile_size;
+        for (int i = 0; i < quads.size(); i++)
+        {
+            const sprite_quad_data &quad = quads[i];
+            const sprite_data &sprite = *quad.sprite;
+
+            // fixing bitmap scaling position (scaling is around the center of the drawn part)
+            double pos_x = quad.x + sprite.pivot_x * (quad.scaling - 1);
+            double pos_y = quad.y + sprite.pivot_y * (quad.scaling - 1);
+
+            drawing_options options = option_part_bmp(sprite.part, option_scale_bmp(quad.scaling, quad.scaling));
+            draw_bitmap(sprite.texture, pos_x, pos_y, quad.flip ? option_flip_y(options) : options);
+
+            if (i == 0 || quads[i - 1].sprite->texture != sprite.texture)
+                texture_batch_count++;
+            if (i == 0 || quads[i - 1].sprite->model != sprite.model)
+                separate_batch_count++;
+        }
+
+        frame_count++;
+        quad_count += quads.size();
+        quads.clear();
     }
 
-    const vector<rectangle> &get_walls_vector() const
+    // reporting the sprites drawn each frame, and the texture batches they took with and without the atlas
+    void report() const
     {
-        return walls_vector;
+        if (frame_count > 0)
+        {
+            write_line("Sprite batch: " + std::to_string((double)quad_count / frame_count) + " sprites per frame in " +
+                       std::to_string((double)texture_batch_count / frame_count) + " texture batches (" +
+                       std::to_string((double)separate_batch_count / frame_count) + " without the atlas)");
+        }
     }
+};
 
-    double get_tile_size() const
+// make a game size struct
+class game_size_data
+{
+private:
+    int screen_height; // the height of the screen
+    int screen_width;  // the width of the screen
+    int room_width;    // the number of tiles in the room on the x axis
+    int room_height;   // the number of tiles in the room on the y axis
+    double zoom_level; // the zoom level of the game or screen
+
+public:
+    // Constructor
+    game_size_data(int screen_width, int screen_height, int room_width, int room_height)
     {
-        return tile_size;
+        this->screen_height = screen_height;
+        this->screen_width = screen_width;
+        this->room_width = room_width;
+        this->room_height = room_height;
+        this->zoom_level = 1;
     }
 
-    const color *get_color_pattern() const
+    game_size_data() : game_size_data(1080, 1920, 40, 30) {}
+
+    // getters and setters
+    int get_screen_height() const
     {
-        return color_pattern;
+        return screen_height;
+    }
+    // screen width is calculated using the screen height and the room width and height
+    int get_screen_width() const
+    {
+        return screen_width;
     }
 
-    // sets the wall of the room, using a start and end tile coordinate
-    //(the wall is the rectangle from the top left corner of start tile to the bottom right corner of end tile)
-    void set_wall(const coordinate &start_tile, const coordinate &end_tile)
+    int get_room_width() const
     {
-        coordinate wall_coords_start = start_tile;
+        return room_width;
+    }
 
-        // tile_to_pixel returns the top left corner of the tile, so we need to add the size of the tile to get the bottom right corner
-        coordinate wall_coords_end = end_tile;
-        vector<coordinate> wall_coords_vector = {wall_coords_start, wall_coords_end};
-        walls_coords_vector.push_back(wall_coords_vector);
+    int get_room_height() const
+    {
+        return room_height;
     }
 
-    void set_color_pattern(const color &floor_color_1, const color &floor_color_2, const color &wall_color)
+    double get_zoom_level() const
     {
-        color_pattern[0] = floor_color_1;
-        color_pattern[1] = floor_color_2;
-        color_pattern[2] = wall_color;
+        return zoom_level;
     }
 
+    // set the zoom level of the game
     void set_zoom_level(double zoom_level)
     {
         this->zoom_level = zoom_level;
     }
+
+    // get the camera position that would keep the parameter coorindate in the center of the screen
+    coordinate get_camera_position(coordinate center_position) const
+    {
+        return {center_position.x - (get_screen_width() / 2), center_position.y - (screen_height / 2)};
+    }
 };
 
-class character_data
+// camera of the game, the game is simulated in world coordinates (unzoomed pixels) and the camera applies the zoom when drawing
+class camera_data
 {
 private:
-    int health;
-    double speed; // pixels per second
-
-    rectangle hurtbox; // the box that determines the player's collision
-    bitmap character_model;
-    bool model_facing_right; // models are drawn facing right, this is used to determine if the model should be flipped
-    double model_scaling;    // scaling of the model, character model is scaled by this value (character model is made at 5x10 pixels)
+    double zoom_level;   // zoom level used for drawing this frame
+    coordinate position; // top left corner of the camera (in zoomed pixels)
+    int screen_width;    // size of the screen the camera covers
+    int screen_height;
 
-    double zoom_level;           // zoom level of the screen to adjust the size of the model and posiion of the model
-    double zoomed_model_scaling; // model scaling after zooming
+public:
+    // Constructor
+    camera_data()
+    {
+        zoom_level = 1;
+        position = {0, 0};
+        screen_width = 0;
+        screen_height = 0;
+    }
 
-    coordinate position;        // position of the character in correlation to the screen (non-zoomed)
-    coordinate zoomed_position; // position of the character in correlation to the room (after zooming), only used for drawing
+    // update the zoom level and move the camera to keep the world coordinate in the center of the screen, must be called before drawing
+    void update(const game_size_data &game_size, const coordinate &world_center)
+    {
+        zoom_level = game_size.get_zoom_level();
+        screen_width = game_size.get_screen_width();
+        screen_height = game_size.get_screen_height();
+        position = game_size.get_camera_position(get_zoomed(world_center));
+        set_camera_position({position.x, position.y});
+    }
 
-    void update_zoomed_position()
+    // convert a world coordinate to the zoomed coordinate it is drawn at
+    coordinate get_zoomed(const coordinate &world_coords) const
     {
-        zoomed_position = {position.x * zoom_level, position.y * zoom_level};
+        return {world_coords.x * zoom_level, world_coords.y * zoom_level};
     }
 
-protected:
-    // constructor
-    character_data(int health, double speed, const bitmap &model, bool model_facing_right, double model_size, const coordinate &spawn_coords)
+    // convert a world rectangle to the zoomed rectangle it is drawn at
+    rectangle get_zoomed(const rectangle &world_rectangle) const
     {
-        // setting player
-        character_model = model;
-        this->model_facing_right = model_facing_right; // depending on the drawn model, the player might be facing right or left
-        this->health = health;
-        this->speed = speed; // pixels per milisecond
-        zoom_level = 1;
+        return {world_rectangle.x * zoom_level, world_rectangle.y * zoom_level, world_rectangle.width * zoom_level, world_rectangle.height * zoom_level};
+    }
 
-        // setting the model size, calculated by the smallest side of the model
-        set_model_size(model_size);
+    // check if a world rectangle is on the screen
+    bool is_visible(const rectangle &world_rectangle) const
+    {
+        return rect_on_screen(get_zoomed(world_rectangle));
+    }
 
-        position = {spawn_coords.x, spawn_coords.y};
+    // get the part of the world (in world pixels) that is on the screen
+    rectangle get_world_view() const
+    {
+        return {position.x / zoom_level, position.y / zoom_level, screen_width / zoom_level, screen_height / zoom_level};
+    }
 
-        // setting the zoomed model scaling, hurtbox, and zoomed position
-        update_zoomed_position();
-        update_zoomed_model_scaling();
-        update_hurtbox();
+    double get_zoom_level() const
+    {
+        return zoom_level;
     }
 
-    // update the position of the hurtbox as the character moves (align with character's position)
-    void update_hurtbox()
+    const coordinate &get_position() const
     {
-        double model_width = bitmap_width(character_model);
-        double model_height = bitmap_height(character_model);
-        hurtbox = {zoomed_position.x, zoomed_position.y, model_width * zoomed_model_scaling, model_height * zoomed_model_scaling};
+        return position;
     }
+};
+
+// class to hold the timing data of the game, the game is simulated in fixed ticks and drawn in between them
+// the real time passed is added to an accumulator at the time rate, and a tick is taken out of it for each update
+class game_timing_data
+{
+private:
+    double tick_time;       // game time simulated by each update (ms)
+    double time_rate;       // how many seconds the game should load in one second
+    double accumulator;     // game time waiting to be simulated (ms)
+    double last_clock_time; // the clock time of the last advance (ms)
 
-    // update the zoomed model scaling (model scaling after zooming)
-    void update_zoomed_model_scaling()
+public:
+    // Constructor, tick_rate is the number of updates for each second of game time
+    game_timing_data(int tick_rate)
     {
-        zoomed_model_scaling = model_scaling * zoom_level;
+        tick_time = 1000.0 / tick_rate;
+        time_rate = 1;
+        accumulator = 0;
+        last_clock_time = 0;
     }
 
-    // getters and setters
-    // set the size of the model (scaling of the model)
-    void set_model_size(double model_size)
+    game_timing_data() : game_timing_data(60) {}
+
+    // must be ran inside a game loop before the updates, time is the current time of the game's clock (ms)
+    // a long pause (such as dragging the window) only counts as a few ticks, so the game does not race to catch up
+    void advance(double time)
     {
-        double model_width = bitmap_width(character_model);
-        double model_height = bitmap_height(character_model);
+        const double MAX_FRAME_TIME = 250; // ms
 
-        // determining the scaling of the model, the smallest side will be scaled to the model_size
-        if (model_width < model_height)
-        {
-            model_scaling = model_size / model_width;
-        }
-        else
-        {
-            model_scaling = model_size / model_height;
-        }
+        double frame_time = time - last_clock_time;
+        last_clock_time = time;
+        accumulator += std::min(frame_time, MAX_FRAME_TIME) * time_rate;
     }
 
-    void set_zoomed_position(const coordinate &zoomed_position)
+    // move the clock to time without simulating the time passed since the last advance, used after a pause such as loading
+    void resync(double time)
     {
-        this->zoomed_position = zoomed_position;
+        last_clock_time = time;
     }
 
-    // return the model (bitmap) of the character
-    const bitmap &get_model() const
+    // take a tick out of the accumulator, returns false if less than a tick of game time is waiting
+    bool take_tick()
     {
-        return character_model;
+        if (accumulator < tick_time)
+        {
+            return false;
+        }
+        accumulator -= tick_time;
+        return true;
     }
 
-    // get the direction the character is facing (direction of the model)
-    bool get_is_facing_right() const
+    // setters and getters
+    // game time of each update (ms)
+    double get_delta_time() const
     {
-        return model_facing_right;
+        return tick_time;
     }
 
-    // get the scaling of the model
-    double get_zoomed_model_scaling() const
+    // real time each update stands for at the current time rate (ms), used for effects that are not slowed down
+    double get_time_difference() const
     {
-        return zoomed_model_scaling;
+        return tick_time / time_rate;
     }
 
-    double get_zoom_level() const
+    // how far the clock is between the last update and the next one (0 to 1), used to draw between updates
+    double get_interpolation() const
     {
-        return zoom_level;
+        return std::min(accumulator / tick_time, 1.0);
     }
 
-    void set_position(const coordinate &position)
+    // set time rate, changes how fast game time passes
+    void set_time_rate(double rate)
     {
-        this->position = position;
+        time_rate = rate;
     }
+};
 
-    void set_health(int health)
+// sleeps between frames so the window is drawn at the frame rate without keeping a core busy
+class frame_pacer_data
+{
+private:
+    std::chrono::steady_clock::duration frame_duration;
+    std::chrono::steady_clock::time_point next_frame; // deadline of the next frame
+
+public:
+    // Constructor, frame rate of 0 is uncapped (never sleeps)
+    frame_pacer_data(int frame_rate)
     {
-        this->health = health;
+        frame_duration = frame_rate > 0 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frame_rate)) : std::chrono::steady_clock::duration::zero();
+        next_frame = std::chrono::steady_clock::now();
     }
 
-    // get position of the character in colleration to the room
-    const coordinate &get_zoomed_position() const
+    // sleep until the next frame is due, a frame that ran late moves the deadline instead of making the next frames rush
+    void wait()
     {
-        return zoomed_position;
+        next_frame += frame_duration;
+        auto now = std::chrono::steady_clock::now();
+        if (next_frame < now)
+        {
+            next_frame = now;
+            return;
+        }
+        std::this_thread::sleep_until(next_frame);
     }
+};
 
-public:
-    // update the character's position and hurtbox, should always be ran inside the game loop
-    void update()
+// floor tiles are stored as a single byte, the low bits are the index of the tile's color in the room's color pattern
+// and the high bit is set when the tile is passable (tiles are kept in tile coordinates, pixel rectangles are derived when needed)
+typedef unsigned char tile_data;
+
+const tile_data TILE_COLOR_MASK = 0x03; // bits used for the color pattern index (0 and 1 is the floor, 2 is the walls)
+const tile_data TILE_PASSABLE = 0x80;   // bit set when the tile can be walked on
+
+// tiles are stored in square chunks of 32 x 32, so only the parts of a room that are used take memory
+const int TILE_CHUNK_SHIFT = 5;
+const int TILE_CHUNK_SIZE = 1 << TILE_CHUNK_SHIFT;
+const int TILE_CHUNK_AREA = TILE_CHUNK_SIZE * TILE_CHUNK_SIZE;
+
+// the tiles of a room, kept in chunks that are generated the first time one of their tiles is read
+// a generated chunk is the checkered floor, tiles filled after that (the walls) make the chunk dirty
+// trim keeps the most recently used chunks, a dirty chunk that is trimmed keeps its difference from the generated floor run-length encoded
+// reading is safe from any thread (a missing chunk is generated under a lock), writing and trimming must only happen on one thread while nothing reads
+class tile_chunk_store_data
+{
+private:
+    struct tile_chunk_data
     {
-        // no need to update if the character is dead
-        if (get_health() <= 0)
+        tile_data tiles[TILE_CHUNK_AREA];
+    };
+
+    int size_x, size_y;
+    int chunks_x, chunks_y;
+    std::unique_ptr<std::atomic<tile_chunk_data *>[]> chunks; // nullptr for chunks that are not in memory
+    std::unique_ptr<std::atomic<unsigned int>[]> last_used;   // the use_clock of the last read of each chunk
+    vector<bool> dirty;                                       // the chunk's tiles differ from the generated ones
+    vector<vector<unsigned char>> cold;                       // trimmed dirty chunks, as (run length, tile ^ generated tile) pairs
+    mutable std::atomic<int> resident_count;
+    mutable std::mutex generate_lock;
+    unsigned int use_clock; // moved on by each trim, so reads since the last trim are the most recent
+
+    // the tile a chunk starts with, the floor's checkered pattern (color index 0 and 1 alternate on each row and column)
+    static tile_data generated_tile(int x, int y)
+    {
+        return TILE_PASSABLE | (tile_data)((x + y) & 1);
+    }
+
+    // fill a chunk with its generated tiles
+    void fill_generated(int chunk, tile_chunk_data *resident) const
+    {
+        int first_x = (chunk % chunks_x) << TILE_CHUNK_SHIFT;
+        int first_y = (chunk / chunks_x) << TILE_CHUNK_SHIFT;
+        for (int i = 0; i < TILE_CHUNK_AREA; i++)
         {
-            return;
+            resident->tiles[i] = generated_tile(first_x + (i & (TILE_CHUNK_SIZE - 1)), first_y + (i >> TILE_CHUNK_SHIFT));
         }
-
-        update_zoomed_position();
-        update_zoomed_model_scaling();
-        update_hurtbox();
     }
 
-    // move the character in a direction by a distance
-    void move(vector_2d &direction, double distance, const room_data &room)
+    // make a chunk from the generated floor and its cold copy if it was trimmed while dirty
+    tile_chunk_data *generate(int chunk) const
     {
-        if (direction.x != 0 || direction.y != 0)
+        std::lock_guard<std::mutex> guard(generate_lock);
+        tile_chunk_data *resident = chunks[chunk].load(std::memory_order_acquire);
+        if (resident != nullptr)
         {
-            direction = unit_vector(direction); // convert to unit vector
+            return resident; // another thread generated it while this one waited
         }
 
-        vector_2d movement = vector_multiply(direction, distance);
-        coordinate new_position = {position.x + movement.x, position.y + movement.y};
-        // set_position(new_position);
+        resident = new tile_chunk_data();
+        fill_generated(chunk, resident);
 
-        // array with all the walls in the room
-        const vector<rectangle> &walls_vector = room.get_walls_vector();
-
-        // checking the collision of player hurtbox with each walls
-        for (int i = 0; i < walls_vector.size(); i++)
+        const vector<unsigned char> &runs = cold[chunk];
+        for (int i = 0, tile = 0; i + 1 < runs.size(); i += 2)
         {
-
-            // the box of the collision (intersection of the player hurtbox and the wall)
-            rectangle collision_box = intersection(hurtbox, walls_vector[i]);
-            if (collision_box.width != 0 && collision_box.height != 0) // if there is a collision
+            for (int end = tile + runs[i]; tile < end; tile++)
             {
-                if (collision_box.height < collision_box.width)
-                {
-
-                    // checking if player moves by y + collision_box.height will still cause collision
-                    hurtbox.y += collision_box.height;
-                    if (intersection(hurtbox, walls_vector[i]).height == 0)
-                    {
-                        // if no collision, then move the player by y + collision_box.height
-                        new_position = {new_position.x, (new_position.y + collision_box.height)};
-                    }
-                    // hurtbox_copy.y = new_position.y - collision_box.height;
-                    else
-                    {
-                        // if collision, then move the player by y - collision_box.height
-                        new_position = {new_position.x, (new_position.y - collision_box.height)};
-                    }
-                }
-
-                if (collision_box.height > collision_box.width)
-                {
-                    // checking if player moves by x + collision_box.width will still cause collision
-                    hurtbox.x += collision_box.width;
-                    if (intersection(hurtbox, walls_vector[i]).width != 0)
-                    {
-                        // if no collision, then move the player by x + collision_box.width
-                        new_position = {(new_position.x - collision_box.width), new_position.y};
-                    }
-                    // hurtbox_copy.x = new_position.x - collision_box.width;
-                    else
-                    {
-                        // if collision, then move the player by x - collision_box.width
-                        new_position = {(new_position.x + collision_box.width), new_position.y};
-                    }
-                }
+                resident->tiles[tile] ^= runs[i + 1];
             }
         }
 
-        set_position(new_position);
+        chunks[chunk].store(resident, std::memory_order_release);
+        resident_count++;
+        return resident;
     }
 
-    // draw the character onto the screen
-    void draw() const
+    tile_chunk_data *get_chunk(int chunk) const
     {
-        if (get_health() <= 0)
+        tile_chunk_data *resident = chunks[chunk].load(std::memory_order_acquire);
+        if (resident == nullptr)
         {
-            return;
+            resident = generate(chunk);
         }
+        if (last_used[chunk].load(std::memory_order_relaxed) != use_clock)
+        {
+            last_used[chunk].store(use_clock, std::memory_order_relaxed);
+        }
+        return resident;
+    }
 
-        double model_width = bitmap_width(get_model());
-        double model_height = bitmap_height(get_model());
-        double zoomed_model_scaling = get_zoomed_model_scaling();
-
-        // fixing bitmap scaling position
-        double pos_x = get_zoomed_position().x + (((model_width * zoomed_model_scaling) - model_width) / 2);
-        double pos_y = get_zoomed_position().y + (((model_height * zoomed_model_scaling) - model_height) / 2);
-
-        // flip when facing opposite direction
-        if (get_is_facing_right())
+    // drop a chunk from memory, encoding it first if it is dirty
+    void evict(int chunk)
+    {
+        tile_chunk_data *resident = chunks[chunk].load(std::memory_order_relaxed);
+        if (dirty[chunk])
         {
-            draw_bitmap(get_model(), pos_x, pos_y, option_scale_bmp(zoomed_model_scaling, zoomed_model_scaling));
+            int first_x = (chunk % chunks_x) << TILE_CHUNK_SHIFT;
+            int first_y = (chunk / chunks_x) << TILE_CHUNK_SHIFT;
+            vector<unsigned char> &runs = cold[chunk];
+            runs.clear();
+            bool changed = false;
+            for (int i = 0; i < TILE_CHUNK_AREA;)
+            {
+                unsigned char difference = resident->tiles[i] ^ generated_tile(first_x + (i & (TILE_CHUNK_SIZE - 1)), first_y + (i >> TILE_CHUNK_SHIFT));
+                int run = 1;
+                while (i + run < TILE_CHUNK_AREA && run < 255 &&
+                       (resident->tiles[i + run] ^ generated_tile(first_x + ((i + run) & (TILE_CHUNK_SIZE - 1)), first_y + ((i + run) >> TILE_CHUNK_SHIFT))) == difference)
+                {
+                    run++;
+                }
+                runs.push_back((unsigned char)run);
+                runs.push_back(difference);
+                changed = changed || difference != 0;
+                i += run;
+            }
+            if (!changed)
+            {
+                runs.clear(); // written back to the generated tiles
+            }
+            runs.shrink_to_fit();
+            dirty[chunk] = false;
         }
-        else
+
+        delete resident;
+        chunks[chunk].store(nullptr, std::memory_order_relaxed);
+        resident_count--;
+    }
+
+public:
+    // Constructor, no chunk is in memory until one of its tiles is read or written
+    tile_chunk_store_data(int size_x, int size_y)
+    {
+        this->size_x = size_x;
+        this->size_y = size_y;
+        chunks_x = (size_x + TILE_CHUNK_SIZE - 1) >> TILE_CHUNK_SHIFT;
+        chunks_y = (size_y + TILE_CHUNK_SIZE - 1) >> TILE_CHUNK_SHIFT;
+        int chunk_count = chunks_x * chunks_y;
+        chunks.reset(new std::atomic<tile_chunk_data *>[chunk_count]);
+        last_used.reset(new std::atomic<unsigned int>[chunk_count]);
+        for (int i = 0; i < chunk_count; i++)
         {
-            draw_bitmap(get_model(), pos_x, pos_y, option_flip_y(option_scale_bmp(zoomed_model_scaling, zoomed_model_scaling)));
+            chunks[i] = nullptr;
+            last_used[i] = 0;
         }
+        dirty.assign(chunk_count, false);
+        cold.assign(chunk_count, {});
+        resident_count = 0;
+        use_clock = 1;
     }
 
-    // check if the character's hurtbox is colliding with a hitbox
-    void check_hitbox_collision(const rectangle &hitbox)
+    tile_chunk_store_data(const tile_chunk_store_data &) = delete;
+    tile_chunk_store_data &operator=(const tile_chunk_store_data &) = delete;
+
+    // Destructor, frees the chunks in memory
+    ~tile_chunk_store_data()
     {
-        rectangle collision_box = intersection(hurtbox, hitbox);
-        if (collision_box.width != 0 && collision_box.height != 0)
+        for (int i = 0; i < chunks_x * chunks_y; i++)
         {
-            // if there is a collision, decrease the health of the character
-            health--;
+            delete chunks[i].load(std::memory_order_relaxed);
         }
     }
-    // getters and setters
-    double get_speed() const
+
+    // get a tile, the tile must be inside the room
+    tile_data get(int x, int y) const
     {
-        return speed;
+        const tile_chunk_data *chunk = get_chunk((y >> TILE_CHUNK_SHIFT) * chunks_x + (x >> TILE_CHUNK_SHIFT));
+        return chunk->tiles[((y & (TILE_CHUNK_SIZE - 1)) << TILE_CHUNK_SHIFT) + (x & (TILE_CHUNK_SIZE - 1))];
     }
 
-    int get_health() const
+    // set every tile of an area (start and end included), the area must be inside the room
+    void fill(int start_x, int start_y, int end_x, int end_y, tile_data tile)
     {
-        return health;
+        for (int chunk_y = start_y >> TILE_CHUNK_SHIFT; chunk_y <= end_y >> TILE_CHUNK_SHIFT; chunk_y++)
+        {
+            for (int chunk_x = start_x >> TILE_CHUNK_SHIFT; chunk_x <= end_x >> TILE_CHUNK_SHIFT; chunk_x++)
+            {
+                int chunk = chunk_y * chunks_x + chunk_x;
+                tile_chunk_data *resident = get_chunk(chunk);
+                dirty[chunk] = true;
+
+                // the part of the area inside this chunk, in the chunk's tiles
+                int first_x = std::max(start_x, chunk_x << TILE_CHUNK_SHIFT) & (TILE_CHUNK_SIZE - 1);
+                int last_x = std::min(end_x, ((chunk_x + 1) << TILE_CHUNK_SHIFT) - 1) & (TILE_CHUNK_SIZE - 1);
+                int first_y = std::max(start_y, chunk_y << TILE_CHUNK_SHIFT) & (TILE_CHUNK_SIZE - 1);
+                int last_y = std::min(end_y, ((chunk_y + 1) << TILE_CHUNK_SHIFT) - 1) & (TILE_CHUNK_SIZE - 1);
+                for (int y = first_y; y <= last_y; y++)
+                {
+                    std::fill(resident->tiles + (y << TILE_CHUNK_SHIFT) + first_x, resident->tiles + (y << TILE_CHUNK_SHIFT) + last_x + 1, tile);
+                }
+            }
+        }
     }
 
-    const coordinate &get_position() const
+    // go back to the generated floor everywhere, the chunks in memory are kept and filled again
+    void clear()
     {
-        return position;
+        for (int i = 0; i < chunks_x * chunks_y; i++)
+        {
+            tile_chunk_data *resident = chunks[i].load(std::memory_order_relaxed);
+            if (resident != nullptr && (dirty[i] || !cold[i].empty()))
+            {
+                fill_generated(i, resident);
+            }
+            dirty[i] = false;
+            cold[i] = {};
+        }
     }
 
-    // set the direction the character is facing (true is right, false is left)
-    void set_is_facing_right(bool facing_right)
+    // keep at most max_resident chunks in memory, dropping the ones read longest ago
+    void trim(int max_resident)
     {
-        model_facing_right = facing_right;
+        if (resident_count > max_resident)
+        {
+            vector<std::pair<unsigned int, int>> resident; // (last used, chunk)
+            for (int i = 0; i < chunks_x * chunks_y; i++)
+            {
+                if (chunks[i].load(std::memory_order_relaxed) != nullptr)
+                {
+                    resident.push_back({last_used[i].load(std::memory_order_relaxed), i});
+                }
+            }
+            int evict_count = resident.size() - std::max(0, max_resident);
+            std::nth_element(resident.begin(), resident.begin() + evict_count - 1, resident.end());
+            for (int i = 0; i < evict_count; i++)
+            {
+                evict(resident[i].second);
+            }
+        }
+        use_clock++;
     }
 
-    // set character's zoom level (to zoom with the screen)
-    void set_zoom_level(double zoom_level)
+    // bytes used by the chunks in memory and the encoded ones
+    long long get_memory_size() const
     {
-        this->zoom_level = zoom_level;
+        long long bytes = (long long)resident_count * sizeof(tile_chunk_data);
+        for (int i = 0; i < cold.size(); i++)
+        {
+            bytes += cold[i].capacity();
+        }
+        return bytes;
     }
 
-    // get the player's center position on the screen
-    coordinate get_center_position() const
+    int get_resident_count() const
     {
-        return {zoomed_position.x + (bitmap_width(get_model()) * get_zoomed_model_scaling()) / 2, zoomed_position.y + (bitmap_height(get_model()) * get_zoomed_model_scaling()) / 2};
+        return resident_count;
     }
 
-    // get the hurtbox of the character
-    const rectangle &get_hurtbox() const
+    int get_chunk_count() const
     {
-        return hurtbox;
+        return chunks_x * chunks_y;
     }
 };
 
-// class for npcs in the game
-class npc_data : public character_data
+// one bit for each tile of a room, set on the top left tiles where a footprint (in tiles) fits (a 1 x 1 footprint is the passable tiles)
+// a row of a chunk is one word (bit i is the i-th tile from the chunk's left edge), the chunks are built the first time they are read
+struct tile_bits_data
+{
+    int width, height;                          // size of the footprint in tiles
+    vector<unsigned int> rows;                  // TILE_CHUNK_SIZE rows for each chunk, in the order of the tile chunks
+    std::unique_ptr<std::atomic<bool>[]> built; // the chunk's rows are up to date with the walls
+};
+
+static_assert(TILE_CHUNK_SIZE == 32, "a row of a chunk of tile bits must fit in an unsigned int");
+
+// flooring struct, using tiles stored in chunks
+class room_data
 {
 private:
-    coordinate new_position;        // the position the npc is moving to
-    coordinate zoomed_new_position; // the position the npc is moving to after zooming
+    std::unique_ptr<tile_chunk_store_data> tiles; // the floor of the room, chunks are generated as they are used
+    int max_resident_chunks;                      // chunks kept in memory after trim_tiles
 
-    double auto_move_max_distance;        // the range at which the new_position can be from its current position (in a square)
-    double zoomed_auto_move_max_distance; // the range at which the new_position can be from its current position (in a square) after zooming
+    // contains the start and end tile coordinates of the walls
+    // elements are coordinate vectors of two elements, the first element is the start tile, the second element is the end tiles
+    vector<vector<coordinate>> walls_coords_vector;
 
-    int time_since_new_position; // the time since the npc has a new position
-    int new_position_cooldown;   // the time the npc should have a new position
+    color color_pattern[3]; // 0 and 1 is the floor checkers color pattern, 2 is the walls
+    int size_y;             // room height
+    int size_x;             // room width
+    int chunks_x, chunks_y; // the room's size in tile chunks
+    double tile_size;       // size of each tile (in world pixels)
+    coordinate spawn_coords;
 
-    // generates a random position for the npc, that is valid for the npc to move to, or stay at
-    void update_new_position(const room_data &room, coordinate min_coords, coordinate max_coords)
+    // the passable tiles and the positions of each footprint size that has been queried, as bits
+    // their chunks are built on the first query that reads them after the walls change, so queries only read the tile chunks they cover
+    mutable tile_bits_data passable_bits;
+    mutable vector<std::unique_ptr<tile_bits_data>> footprint_bits;
+    mutable std::recursive_mutex free_space_lock; // held while building a chunk of bits (building footprint bits reads the passable bits)
+    mutable bool free_space_outdated;
+    int walls_version; // increased every time the walls change, so other structures built from the walls know to rebuild
+
+    // the floor and walls are pre-rendered into a bitmap with one pixel per tile, it is scaled up by the tile size when drawn
+    // a chunk of it is rendered the first time it is on the screen after the walls or colors change
+    bitmap floor_layer;
+    bool floor_layer_outdated;          // true when the walls changed since the floor layer was rendered
+    unsigned int rendered_pattern[3]; // the color pattern the floor layer was rendered with, as 8 bit rgb
+    vector<bool> floor_chunk_rendered;  // the chunks of the floor layer rendered with rendered_pattern
+
+    // a function to construct the room, used in the constructor
+    void construct_room(int room_width, int room_height, int screen_width, int screen_height, const color &floor_color_1, const color &floor_color_2, const color &wall_color, const coordinate &spawn_tile)
+    {
+        color_pattern[0] = floor_color_1;
+        color_pattern[1] = floor_color_2;
+        color_pattern[2] = wall_color;
+        this->size_x = room_width;
+        this->size_y = room_height;
+        this->chunks_x = (size_x + TILE_CHUNK_SIZE - 1) >> TILE_CHUNK_SHIFT;
+        this->chunks_y = (size_y + TILE_CHUNK_SIZE - 1) >> TILE_CHUNK_SHIFT;
+        this->floor_layer = nullptr; // created when the room is first drawn
+        this->floor_layer_outdated = true;
+        this->rendered_pattern[0] = this->rendered_pattern[1] = this->rendered_pattern[2] = 0;
+        this->floor_chunk_rendered.assign(chunks_x * chunks_y, false);
+        this->free_space_outdated = true;
+        this->walls_version = 0;
+        reset_bits(passable_bits, 1, 1);
+
+        double size1 = (double)screen_width / (double)room_width;
+        double size2 = (double)screen_height / (double)room_height;
+        if (size1 >= size2)
+            this->tile_size = size1;
+        else
+            this->tile_size = size2;
+
+        this->spawn_coords = spawn_tile;
+
+        // setting spawn coordinates, it is passed as a tile coordinate
+        this->spawn_coords = this->spawn_coords.tile_to_pixel(tile_size);
+
+        // the floor is generated a chunk at a time as it is used, walls are written into it as they are set
+        tiles.reset(new tile_chunk_store_data(size_x, size_y));
+        max_resident_chunks = 4096; // 4 MB of tiles
+
+        // setting the wall (surronding the room)
+        set_wall({0, 0}, {(double)(size_x - 1), 0});                                       // top wall
+        set_wall({0, 1}, {0, (double)(size_y - 2)});                                       // left wall
+        set_wall({(double)(size_x - 1), 1}, {(double)(size_x - 1), (double)(size_y - 2)}); // right wall
+        set_wall({0, (double)(size_y - 1)}, {(double)(size_x - 1), (double)(size_y - 1)}); // bottom wall
+    }
+
+    // build the floor of the room (the passable checkered tiles, generated again as the chunks are used)
+    void build_floor()
     {
-        min_coords = min_coords.pixel_to_tile(room.get_zoomed_tile_size());
-        max_coords = max_coords.pixel_to_tile(room.get_zoomed_tile_size());
+        tiles->clear();
+    }
 
-        coordinate rand_position;
+    // a color as 8 bit rgb, colors that are the same on the screen are the same number
+    static unsigned int to_rgb_8(const color &pattern_color)
+    {
+        unsigned int r = std::min(255, std::max(0, (int)(pattern_color.r * 255 + 0.5)));
+        unsigned int g = std::min(255, std::max(0, (int)(pattern_color.g * 255 + 0.5)));
+        unsigned int b = std::min(255, std::max(0, (int)(pattern_color.b * 255 + 0.5)));
+        return (r << 16) | (g << 8) | b;
+    }
 
-        do
+    // check if the color pattern looks different from the one the floor layer was rendered with
+    bool is_pattern_changed() const
+    {
+        for (int i = 0; i < 3; i++)
         {
-            // generating a random position for the npc to move to converting to tile coordinates
-            rand_position = random_coordinate(min_coords, max_coords);
-            // checking if the tile is within the room
-            if (rand_position.x < 0 || rand_position.x >= room.get_size_x() || rand_position.y < 0 || rand_position.y >= room.get_size_y())
+            if (to_rgb_8(color_pattern[i]) != rendered_pattern[i])
             {
-                continue;
+                return true;
             }
+        }
+        return false;
+    }
 
-            // make sure the npc can fit inside the new position
-            int player_tile_height = (int)ceil(get_hurtbox().height / room.get_zoomed_tile_size());
-            int player_tile_width = (int)ceil(get_hurtbox().width / room.get_zoomed_tile_size());
-            vector<coordinate> player_tiles;
+    // round down or up to an int, without calling floor or ceil (used by the movement sweeps, which run for every character every frame)
+    static int floor_to_int(double value)
+    {
+        int result = (int)value;
+        return result - (value < result ? 1 : 0);
+    }
+
+    static int ceil_to_int(double value)
+    {
+        int result = (int)value;
+        return result + (value > result ? 1 : 0);
+    }
+
+    // sweep one axis of a box, position and size are along the moving axis, cross position and size are along the other axis
+    double sweep_box_axis(double box_position, double box_size, double cross_position, double cross_size, double distance, bool x_axis) const
+    {
+        if (distance == 0)
+        {
+            return 0;
+        }
+
+        // small error allowed so that boxes resting exactly on a tile edge do not count the next tile as covered
+        const double EDGE_ERROR = 1e-9;
+
+        // the rows (or columns) the box covers across the moving axis
+        int cross_start = floor_to_int(cross_position / tile_size + EDGE_ERROR);
+        int cross_end = ceil_to_int((cross_position + cross_size) / tile_size - EDGE_ERROR) - 1;
+
+        if (distance > 0)
+        {
+            // the tiles the front edge of the box moves into, checked from nearest to furthest
+            double front = box_position + box_size;
+            int first = ceil_to_int(front / tile_size - EDGE_ERROR);
+            int last = ceil_to_int((front + distance) / tile_size - EDGE_ERROR) - 1;
 
-            for (int i = 0; i < player_tile_height; i++)
+            for (int i = first; i <= last; i++)
             {
-                for (int j = 0; j < player_tile_width; j++)
+                if (!is_line_passable(i, cross_start, cross_end, x_axis))
                 {
-                    player_tiles.push_back({rand_position.x + j, rand_position.y + i});
+                    return std::max(0.0, i * tile_size - front);
                 }
             }
+        }
+        else
+        {
+            double front = box_position;
+            int first = floor_to_int(front / tile_size + EDGE_ERROR) - 1;
+            int last = floor_to_int((front + distance) / tile_size + EDGE_ERROR);
 
-            // checking for all tiles the npc will fill in the new position
-            bool valid_position = true;
-
-            for (int i = 0; i < player_tiles.size(); i++)
+            for (int i = first; i >= last; i--)
             {
-                if (!room.is_passable(player_tiles[i]))
+                if (!is_line_passable(i, cross_start, cross_end, x_axis))
                 {
-                    valid_position = false;
-                    break;
+                    return std::min(0.0, (i + 1) * tile_size - front);
                 }
             }
+        }
+
+        return distance;
+    }
 
-            // checking if the npc can fit in the position
-            if (valid_position)
+    // check if all tiles on a column (x_axis) or row are passable between start and end
+    bool is_line_passable(int line, int start, int end, bool x_axis) const
+    {
+        for (int i = start; i <= end; i++)
+        {
+            if (x_axis ? !is_passable(line, i) : !is_passable(i, line))
             {
-                break;
+                return false;
             }
-        } while (true);
-
-        set_new_position(rand_position);
+        }
+        return true;
     }
 
-    // move the npc to a random position within a range automatically
-    void auto_set_new_position(double delta_time, const room_data &room)
+    // make an empty table of bits for a footprint size, every chunk is built on its first read
+    void reset_bits(tile_bits_data &bits, int width, int height) const
     {
-        coordinate position = get_zoomed_position();
-
-        // determines if NPC is at the destination, allows an error of (+-)10 pixel due to the float to int conversion, and other scalings
-        bool x_at_destination = ((int)position.x >= zoomed_new_position.x - 10) && ((int)position.x <= zoomed_new_position.x + 10);
-        bool y_at_destination = ((int)position.y >= zoomed_new_position.y - 10) && ((int)position.y <= zoomed_new_position.y + 10);
-
-        time_since_new_position += delta_time;
-        bool cooldown_passed = time_since_new_position >= new_position_cooldown;
-
-        // if the npc is at the destination or cooldown for new position passed, generate a new destination
-        if ((x_at_destination && y_at_destination) || cooldown_passed)
+        bits.width = width;
+        bits.height = height;
+        bits.rows.assign(chunks_x * chunks_y * TILE_CHUNK_SIZE, 0);
+        bits.built.reset(new std::atomic<bool>[chunks_x * chunks_y]);
+        for (int i = 0; i < chunks_x * chunks_y; i++)
         {
-            coordinate min_coords = {get_zoomed_position().x - zoomed_auto_move_max_distance, get_zoomed_position().y - zoomed_auto_move_max_distance};
-            coordinate max_coords = {get_zoomed_position().x + zoomed_auto_move_max_distance, get_zoomed_position().y + zoomed_auto_move_max_distance};
-
-            update_new_position(room, min_coords, max_coords);
-
-            new_position = new_position.tile_to_pixel(room.get_tile_size()); // converting back to pixel coordinates for the npc to move to
-            time_since_new_position = 0;
+            bits.built[i] = false;
         }
     }
 
-    void auto_move(double delta_time, const room_data &room)
+    // work out the bits of a chunk from the tiles (or from the passable bits for a bigger footprint), the tiles outside the room are 0
+    void build_bits(tile_bits_data &bits, int chunk) const
     {
-        // calculate the direction and distance the npc should move
-        vector_2d direction = {0, 0};
-        direction.x = zoomed_new_position.x - get_zoomed_position().x;
-        direction.y = zoomed_new_position.y - get_zoomed_position().y;
-
-        // set the direction the npc is facing
-        if (direction.x > 0)
+        std::lock_guard<std::recursive_mutex> guard(free_space_lock);
+        if (bits.built[chunk].load(std::memory_order_relaxed))
         {
-            set_is_facing_right(true);
+            return; // another thread built it while this one waited
         }
-        else
+
+        int first_x = (chunk % chunks_x) << TILE_CHUNK_SHIFT;
+        int first_y = (chunk / chunks_x) << TILE_CHUNK_SHIFT;
+        bool single_tile = bits.width == 1 && bits.height == 1;
+        for (int i = 0; i < TILE_CHUNK_SIZE; i++)
         {
-            set_is_facing_right(false);
+            unsigned int row = 0;
+            for (int j = 0; j < TILE_CHUNK_SIZE; j++)
+            {
+                bool set = single_tile ? is_passable(first_x + j, first_y + i) : is_area_passable(first_x + j, first_y + i, bits.width, bits.height);
+                row |= (set ? 1u : 0u) << j;
+            }
+            bits.rows[(chunk << TILE_CHUNK_SHIFT) + i] = row;
         }
-
-        // the distance the npc should move according to delta_time
-        double distance = get_speed() * (double)delta_time;
-
-        move(direction, distance, room);
+        bits.built[chunk].store(true, std::memory_order_release);
     }
 
-    // update values that are affected by zoom level
-    void update_zoomed_auto_move_max_distance()
+    // get the rows of a chunk of bits, building the chunk if it is not built
+    const unsigned int *get_chunk_bits(tile_bits_data &bits, int chunk) const
     {
-        zoomed_auto_move_max_distance = auto_move_max_distance * get_zoom_level();
+        if (!bits.built[chunk].load(std::memory_order_acquire))
+        {
+            build_bits(bits, chunk);
+        }
+        return &bits.rows[chunk << TILE_CHUNK_SHIFT];
     }
 
-    // update values that are affected by zoom level
-    void update_zoomed_new_position()
+    // get a row of a chunk of bits (the row y of the chunk_x column of chunks), building the chunk if it is not built
+    unsigned int get_bits(tile_bits_data &bits, int chunk_x, int y) const
     {
-        zoomed_new_position = {new_position.x * get_zoom_level(), new_position.y * get_zoom_level()};
+        return get_chunk_bits(bits, (y >> TILE_CHUNK_SHIFT) * chunks_x + chunk_x)[y & (TILE_CHUNK_SIZE - 1)];
     }
 
-    // setting new position of the npc (that it will auto move to)
-    void set_new_position(const coordinate &new_position)
+    // count the set bits of a word
+    static int count_bits(unsigned int bits)
     {
-        this->new_position = new_position;
+        bits = bits - ((bits >> 1) & 0x55555555u);
+        bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+        return (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
     }
 
-public:
-    // Constructor
-    npc_data(double tile_size, double model_size, const room_data &room, string bitmap_name)
-        : character_data(1, 4 * tile_size / 1000, bitmap_named(bitmap_name), true, model_size, {0, 0})
+    // the bits of a chunk's row that are inside the tiles first_x to last_x (tile coordinates, both included)
+    static unsigned int get_row_mask(int chunk_x, int first_x, int last_x)
     {
-        auto_move_max_distance = 10 * tile_size;
-        new_position_cooldown = 5000; // ms
-        time_since_new_position = 0;  // ms
-
-        coordinate max = {(double)(room.get_size_x() - 1), (double)(room.get_size_y() - 1)};
-        coordinate min = {0, 0};
-        update_new_position(room, min.tile_to_pixel(room.get_zoomed_tile_size()), max.tile_to_pixel(room.get_zoomed_tile_size()));
-
-        new_position = new_position.tile_to_pixel(room.get_zoomed_tile_size());
-
-        set_position(new_position);
-        update_zoomed_auto_move_max_distance();
-        update_zoomed_new_position();
+        int first = std::max(0, first_x - (chunk_x << TILE_CHUNK_SHIFT));
+        int last = std::min(TILE_CHUNK_SIZE - 1, last_x - (chunk_x << TILE_CHUNK_SHIFT));
+        return (0xFFFFFFFFu >> (TILE_CHUNK_SIZE - 1 - last)) & (0xFFFFFFFFu << first);
     }
 
-    // update the npc's position and hurtbox, should always be ran inside the game loop
-    void update(double delta_time, const room_data &room)
+    // forget the bits of every chunk after the walls change, they are built again as they are read
+    void update_free_space() const
     {
-        // no need to update if the npc is dead
-        if (get_health() <= 0)
+        if (!free_space_outdated)
         {
             return;
         }
 
-        update_zoomed_auto_move_max_distance();
-        update_zoomed_new_position();
-        auto_set_new_position(delta_time, room);
+        for (int i = 0; i < chunks_x * chunks_y; i++)
+        {
+            passable_bits.built[i] = false;
+            for (int j = 0; j < footprint_bits.size(); j++)
+            {
+                footprint_bits[j]->built[i] = false;
+            }
+        }
+        free_space_outdated = false;
+    }
 
-        auto_move(delta_time, room);
+    // get the bits of a footprint size, making the table if it has not been queried before
+    tile_bits_data &get_footprint_bits(int width, int height) const
+    {
+        update_free_space();
 
-        // calls update from character_data base class, updates hitbox and model scaling
-        character_data::update();
+        if (width == 1 && height == 1)
+        {
+            return passable_bits;
+        }
+        for (int i = 0; i < footprint_bits.size(); i++)
+        {
+            if (footprint_bits[i]->width == width && footprint_bits[i]->height == height)
+            {
+                return *footprint_bits[i];
+            }
+        }
+
+        footprint_bits.emplace_back(new tile_bits_data());
+        reset_bits(*footprint_bits.back(), width, height);
+        return *footprint_bits.back();
     }
 
-    void set_health(int health)
+    // render the tiles of the chunks in an area (tile coordinates) into the floor layer bitmap, the chunks already rendered are skipped
+    void render_floor_layer(const rectangle &area)
     {
-        character_data::set_health(health);
-    }
+        TRACE_ZONE("render floor layer");
 
-    // friends with monster_data to allow monster_data to access npc_data's private members (used as disguise)
-    friend class monster_data;
-};
+        if (floor_layer == nullptr)
+        {
+            floor_layer = create_bitmap("room_floor_layer", size_x, size_y);
+        }
 
-enum sword_phase
-{
-    SWORD_DRAW = 0,
-    SWORD_SWING,
-    NO_SWORD
-};
-
-// sword info stuct
-struct sword_data
-{
-    bitmap sword_draw_model;  // bitmap of the sword when the player is drawing the sword
-    bitmap sword_swing_model; // bitmap of the sword when the player is swinging the sword
-    double model_scaling;     // scaling of the sword model
-    coordinate position;      // position of the sword
-    sword_phase phase;        // the phase of the sword (drawing, swinging, or no sword) (used to determine which bitmap to draw)
-};
-
-// player info struct, players can attack
-class player_data : public character_data
-{
-private:
-    int attack_speed;        // ms
-    bool is_attacking;       // if true, the player is attacking, used to check with timing and drawing
-    bool create_hitbox;      // if true, the player's sword will have a hitbox
-    rectangle hitbox;        // the hitbox of the sword, the hitbox is active when the player is attacking
-    int hitbox_lasting_time; // ms
-    double attack_cooldown;  // ms
-    bool can_attack;         // if true, the player can attack, if false, the player is in cooldown
+        int last_x = std::min(size_x, (int)(area.x + area.width)) - 1;
+        int last_y = std::min(size_y, (int)(area.y + area.height)) - 1;
+        for (int chunk_y = std::max(0, (int)area.y) >> TILE_CHUNK_SHIFT; chunk_y <= last_y >> TILE_CHUNK_SHIFT; chunk_y++)
+        {
+            for (int chunk_x = std::max(0, (int)area.x) >> TILE_CHUNK_SHIFT; chunk_x <= last_x >> TILE_CHUNK_SHIFT; chunk_x++)
+            {
+                int chunk = chunk_y * chunks_x + chunk_x;
+                if (floor_chunk_rendered[chunk])
+                {
+                    continue;
+                }
 
-    sword_data sword;
-    double sword_zoomed_model_scaling; // scaling of the sword when zoomed, derived from the sword's model scaling
+                // filling with the first floor color, then only drawing the tiles that use another color
+                int first_x = chunk_x << TILE_CHUNK_SHIFT, first_y = chunk_y << TILE_CHUNK_SHIFT;
+                int end_x = std::min(size_x, first_x + TILE_CHUNK_SIZE), end_y = std::min(size_y, first_y + TILE_CHUNK_SIZE);
+                fill_rectangle_on_bitmap(floor_layer, color_pattern[0], first_x, first_y, end_x - first_x, end_y - first_y);
+                for (int y = first_y; y < end_y; y++)
+                {
+                    for (int x = first_x; x < end_x; x++)
+                    {
+                        int color_index = tiles->get(x, y) & TILE_COLOR_MASK;
+                        if (color_index != 0)
+                        {
+                            draw_pixel_on_bitmap(floor_layer, color_pattern[color_index], x, y);
+                        }
+                    }
+                }
+                floor_chunk_rendered[chunk] = true;
+            }
+        }
+    }
 
-    // main function for attacking, controls the attacking animation, and the time the hitbox is active (according to attack_speed)
-    void attacking()
+    // mark the tiles covered by a wall as walls in the tiles
+    void build_wall(const vector<coordinate> &wall_coords)
     {
-        // if the player is not attacking, the sword phase is set to no sword
-        if (!is_attacking)
+        // the wall covers from the top left corner of the start tile to the bottom right corner of the end tile
+        // any tile overlapping that area (touching does not count) becomes a wall, clipped to the room
+        int start_x = std::max(0, (int)floor(wall_coords[0].x));
+        int start_y = std::max(0, (int)floor(wall_coords[0].y));
+        int end_x = std::min(size_x - 1, (int)ceil(wall_coords[1].x + 1) - 1);
+        int end_y = std::min(size_y - 1, (int)ceil(wall_coords[1].y + 1) - 1);
+
+        // tiles are walls if they use the wall color (color_pattern[2]) and are not passable
+        if (start_x <= end_x && start_y <= end_y)
         {
-            sword.phase = NO_SWORD; // doesnt draw the sword on the screen if the phase is no sword
-            return;
+            tiles->fill(start_x, start_y, end_x, end_y, 2);
         }
+    }
 
-        // NOTE: sword animation and progress takes 2 * attack_speed
-
-        // for the start of the animaion, the player is drawing the sword for attack_speed
-        if (attack_cooldown < attack_speed)
-        {
-            sword.phase = SWORD_DRAW;
-            return;
-        }
+public:
+    // Constructor
+    room_data(int floor_width, int floor_height, int screen_width, int screen_height)
+    {
+        // setting room color
+        color slate_grey = rgb_color(112, 128, 144);
+        color light_slate_grey = rgb_color(132, 144, 153);
+        color light_steel_blue = rgb_color(150, 170, 200);
 
-        // after attakc_speed time, the player is swinging the sword for attack_speed * 0.5
-        if (attack_cooldown < attack_speed * 1.5)
-        {
-            sword.phase = SWORD_SWING;
+        construct_room(floor_width, floor_height, screen_width, screen_height, slate_grey, light_slate_grey, light_steel_blue, {(double)(floor_width - 1) / 2, (double)(floor_height - 1) - 2});
+    }
 
-            // create hitbox when the player is swinging the sword, only for hitbox_lasting_time
-            if (attack_cooldown < attack_speed + hitbox_lasting_time)
-                create_hitbox = true;
-            else
-                create_hitbox = false;
+    room_data(int floor_width, int floor_height, int screen_width, int screen_height, const coordinate &spawn_coords)
+    {
+        // setting room color
+        color slate_grey = rgb_color(112, 128, 144);
+        color light_slate_grey = rgb_color(132, 144, 153);
+        color light_steel_blue = rgb_color(150, 170, 200);
 
-            return;
-        }
-        sword.phase = NO_SWORD; // doesnt draw the sword on the screen if the phase is no sword
+        construct_room(floor_width, floor_height, screen_width, screen_height, slate_grey, light_slate_grey, light_steel_blue, spawn_coords);
     }
 
-    // update the attack cooldown, and the attack state
-    void update_attack_cooldown(double delta_time)
+    room_data(int floor_width, int floor_height, int screen_width, int screen_height, const color &floor_color_1, const color &floor_color_2, const color &wall_color, const coordinate &spawn_coords)
     {
-        attack_cooldown += delta_time;
+        construct_room(floor_width, floor_height, screen_width, screen_height, floor_color_1, floor_color_2, wall_color, spawn_coords);
+    }
 
-        if (attack_cooldown >= attack_speed * 2)
+    // the floor layer bitmap is owned by the room, so rooms cannot be copied
+    room_data(const room_data &) = delete;
+    room_data &operator=(const room_data &) = delete;
+
+    // Destructor
+    ~room_data()
+    {
+        if (floor_layer != nullptr)
         {
-            can_attack = true;
-            is_attacking = false;
-            attack_cooldown = 0;
+            free_bitmap(floor_layer);
         }
-        else
-            can_attack = false;
     }
 
-    // update the sword's hitbox to align with the player's position
-    void update_hitbox()
+    // rebuild the whole floor from the walls, walls are already written into the floor as they are set so this is not needed in the game loop
+    void build_room()
     {
-        double player_model_width = bitmap_width(get_model());
-        double player_model_height = bitmap_height(get_model());
+        TRACE_ZONE("build room");
 
-        double sword_model_width = bitmap_width(sword.sword_draw_model);
-        double sword_model_height = bitmap_height(sword.sword_draw_model);
-        double hitbox_size_x, hitbox_size_y;
+        // building the floor
+        build_floor();
 
-        // player hitbox is 0 if there isnt an attack happening (which is when create_hitbox is false)
-        if (create_hitbox)
-        {
-            hitbox_size_x = sword_model_width * sword_zoomed_model_scaling;
-            hitbox_size_y = sword_model_height * sword_zoomed_model_scaling * (player_model_height / player_model_width);
-            // playermodelheight / playermodelwidth because model_scaling is derived from player_model_width
-        }
-        else
+        // building the walls
+        for (int i = 0; i < walls_coords_vector.size(); i++)
         {
-            hitbox_size_x = 0;
-            hitbox_size_y = 0;
+            build_wall(walls_coords_vector[i]);
         }
 
-        // align the sword's hitbox with the player's direction
-        if (get_is_facing_right())
-            hitbox = {get_zoomed_position().x + (player_model_width * get_zoomed_model_scaling()), get_zoomed_position().y, hitbox_size_x, hitbox_size_y};
-        else
-            hitbox = {get_zoomed_position().x - hitbox_size_x, get_zoomed_position().y, hitbox_size_x, hitbox_size_y};
-    }
-
-    // update the sword's zoom to fit with the zoom_level
-    void update_sword_zoomed_model_scaling()
-    {
-        sword_zoomed_model_scaling = sword.model_scaling * get_zoom_level();
+        floor_layer_outdated = true;
+        free_space_outdated = true;
+        walls_version++;
     }
 
-    // update the sword's position to align with the player's position
-    void update_sword()
+    // draw the room onto the screen, zoomed by the camera (the visible part of the floor layer is re-rendered first if it is outdated)
+    void draw(const camera_data &camera)
     {
-        sword.phase = NO_SWORD; // default phase is no sword
-
-        update_sword_zoomed_model_scaling();
+        TRACE_ZONE("room draw");
 
-        double player_model_width = bitmap_width(get_model());
-        double player_model_height = bitmap_height(get_model());
-
-        double sword_model_width = bitmap_width(sword.sword_draw_model);
-
-        double model_scaling = get_zoomed_model_scaling();
-
-        // making the sword align with the player
-        if (get_is_facing_right())
+        // the chunks are rendered again as they come on the screen after the walls change or the colors change enough to be seen
+        if (floor_layer_outdated || is_pattern_changed())
         {
-            sword.position.x = get_zoomed_position().x + (player_model_width * model_scaling);
-            sword.position.y = get_zoomed_position().y + (player_model_height / (player_model_height / player_model_width) * model_scaling);
+            std::fill(floor_chunk_rendered.begin(), floor_chunk_rendered.end(), false);
+            for (int i = 0; i < 3; i++)
+            {
+                rendered_pattern[i] = to_rgb_8(color_pattern[i]);
+            }
+            floor_layer_outdated = false;
         }
-        else
+
+        // only the tiles inside the camera's view are drawn
+        rectangle visible_tiles = get_visible_tiles(camera);
+        if (visible_tiles.width <= 0 || visible_tiles.height <= 0)
         {
-            sword.position.x = get_zoomed_position().x - (sword_model_width * sword_zoomed_model_scaling);
-            sword.position.y = get_zoomed_position().y + (player_model_height / (player_model_height / player_model_width) * model_scaling);
+            return;
         }
+        render_floor_layer(visible_tiles);
+
+        // each pixel of the floor layer is one tile, so it is scaled by the zoomed tile size
+        double scaling = tile_size * camera.get_zoom_level();
+
+        // fixing bitmap scaling position (scaling is around the center of the drawn part)
+        double pos_x = (visible_tiles.x * scaling) + (((visible_tiles.width * scaling) - visible_tiles.width) / 2);
+        double pos_y = (visible_tiles.y * scaling) + (((visible_tiles.height * scaling) - visible_tiles.height) / 2);
+
+        draw_bitmap(floor_layer, pos_x, pos_y, option_part_bmp(visible_tiles, option_scale_bmp(scaling, scaling)));
     }
 
-    // draw player's sword onto screen
-    void draw_sword() const
+    // get the tiles that are on the screen as a rectangle in tile coordinates (clipped to the room)
+    rectangle get_visible_tiles(const camera_data &camera) const
     {
-        double sword_model_width = bitmap_width(sword.sword_draw_model);
-        double sword_model_height = bitmap_height(sword.sword_draw_model);
-        double scaling = sword_zoomed_model_scaling;
-
-        double player_model_height = bitmap_height(get_model());
-        double player_model_width = bitmap_width(get_model());
+        rectangle view = camera.get_world_view();
 
-        // fixing bitmap scaling position
-        double pos_x = sword.position.x + (((sword_model_width * scaling) - sword_model_width) / 2);
-        double pos_y = sword.position.y + (((sword_model_height * scaling) - sword_model_height) / 2);
+        int start_x = std::max(0, (int)floor(view.x / tile_size));
+        int start_y = std::max(0, (int)floor(view.y / tile_size));
+        int end_x = std::min(size_x, (int)ceil((view.x + view.width) / tile_size));
+        int end_y = std::min(size_y, (int)ceil((view.y + view.height) / tile_size));
 
-        sword_phase model = sword.phase;
+        return {(double)start_x, (double)start_y, (double)(end_x - start_x), (double)(end_y - start_y)};
+    }
 
-        double model_scaling = get_zoomed_model_scaling();
+    // check if a tile coords is passable, tiles outside of the room are not passable
+    bool is_passable(const coordinate &tile_coords) const
+    {
+        return is_passable((int)tile_coords.x, (int)tile_coords.y);
+    }
 
-        // flip when facing opposite direction
-        if (get_is_facing_right())
-        {
-            if (model == SWORD_DRAW)
-                draw_bitmap(sword.sword_draw_model, pos_x, pos_y, option_scale_bmp(scaling, scaling));
-            if (model == SWORD_SWING)
-                draw_bitmap(sword.sword_swing_model, pos_x, pos_y - (player_model_height / (player_model_height / player_model_width) * model_scaling), option_scale_bmp(scaling, scaling));
-        }
-        else
+    bool is_passable(int x, int y) const
+    {
+        if (x < 0 || x >= size_x || y < 0 || y >= size_y)
         {
-            if (model == SWORD_DRAW)
-                draw_bitmap(sword.sword_draw_model, pos_x, pos_y, option_flip_y(option_scale_bmp(scaling, scaling)));
-            if (model == SWORD_SWING)
-                draw_bitmap(sword.sword_swing_model, pos_x, pos_y - (player_model_height / (player_model_height / player_model_width) * model_scaling), option_flip_y(option_scale_bmp(scaling, scaling)));
+            return false;
         }
+        return (tiles->get(x, y) & TILE_PASSABLE) != 0;
     }
 
-public:
-    // Constructor
-    player_data(double tile_size, double model_size, const coordinate &spawn_coords, string bitmap_name)
-        : character_data(1, 5.0 * tile_size / 1000, bitmap_named(bitmap_name), true, model_size, spawn_coords)
+    // move a box (in world pixels) through the room's tiles, first along x and then along y
+    // returns the part of the movement that can be made before the box runs into a wall tile (touching a wall is not a collision)
+    // only the tiles the box passes over are checked, so large movements cannot skip over walls
+    vector_2d sweep_box(const rectangle &box, const vector_2d &movement) const
     {
-        attack_speed = 1000;       // ms
-        hitbox_lasting_time = 100; // ms
-
-        can_attack = true;
-        attack_cooldown = 0;
-        is_attacking = false;
-        create_hitbox = false;
-
-        double model_width = bitmap_width(get_model());
-        double model_height = bitmap_height(get_model());
-
-        // setting sword struct
-        sword.sword_draw_model = bitmap_named("sword_draw");
-        sword.sword_swing_model = bitmap_named("sword_swing");
+        // if every tile the box could pass over is passable, the whole movement can be made (checked a word of passable bits at a time, one for each row and chunk the area covers)
+        const double EDGE_ERROR = 1e-9;
+        int start_x = floor_to_int((box.x + std::min(0.0, movement.x)) / tile_size + EDGE_ERROR);
+        int start_y = floor_to_int((box.y + std::min(0.0, movement.y)) / tile_size + EDGE_ERROR);
+        int end_x = ceil_to_int((box.x + box.width + std::max(0.0, movement.x)) / tile_size - EDGE_ERROR);
+        int end_y = ceil_to_int((box.y + box.height + std::max(0.0, movement.y)) / tile_size - EDGE_ERROR);
+        if (is_area_passable(start_x, start_y, end_x - start_x, end_y - start_y))
+        {
+            return movement;
+        }
 
-        // both sword bitmap have the same size
-        double sword_model_width = bitmap_width(sword.sword_draw_model);
-        double sword_model_height = bitmap_height(sword.sword_draw_model);
+        vector_2d result = {sweep_box_axis(box.x, box.width, box.y, box.height, movement.x, true), 0};
+        result.y = sweep_box_axis(box.y, box.height, box.x + result.x, box.width, movement.y, false);
+        return result;
+    }
 
-        // flip when facing opposite direction
-        if (sword_model_width < sword_model_height)
+    // check if every tile of an area (in tile coordinates) is passable, areas going outside the room are not passable
+    bool is_area_passable(int x, int y, int width, int height) const
+    {
+        if (x < 0 || y < 0 || x + width > size_x || y + height > size_y)
         {
-            sword.model_scaling = model_size / sword_model_width;
+            return false;
         }
 
-        if (sword_model_height < sword_model_width)
+        if (width <= 0 || height <= 0)
         {
-            sword.model_scaling = model_size / sword_model_height;
+            return true;
         }
 
-        update_sword_zoomed_model_scaling();
-        // updating hitbox, hurtbox and model scaling
-        character_data::update();
-        update_hitbox();
-        // calling update to set the sword's position
-        update_sword();
-    }
-
-    player_data(double tile_size, double model_size, string bitmap_name)
-        : player_data(tile_size, model_size, {0, 0}, bitmap_name) {}
-
-    // attack function to call the player to attack (only if the player can attack)
-    void attack()
-    {
-        if (can_attack)
+        update_free_space();
+        for (int row = y; row < y + height; row++)
         {
-            is_attacking = true;
+            for (int chunk_x = x >> TILE_CHUNK_SHIFT; chunk_x <= (x + width - 1) >> TILE_CHUNK_SHIFT; chunk_x++)
+            {
+                unsigned int mask = get_row_mask(chunk_x, x, x + width - 1);
+                if ((get_bits(passable_bits, chunk_x, row) & mask) != mask)
+                {
+                    return false;
+                }
+            }
         }
+        return true;
     }
 
-    // must be ran inside game loop, and get delta_time from game_timing_data
-    void update(double delta_time)
+    // pick a random top left tile inside the range (tile coordinates, min and max included) where a footprint of width x height tiles fits
+    // every valid position has the same chance, returns false if there is no valid position in the range
+    // streams can pick from worker threads once the tables are built, see prepare_free_space
+    bool random_free_position(int width, int height, coordinate min_tile, coordinate max_tile, coordinate &result, random_stream_data &random) const
     {
-        // no need to update if the player is dead
-        if (get_health() <= 0)
+        tile_bits_data &fits = get_footprint_bits(width, height);
+
+        // clipping the range to the room
+        int min_x = std::max(0, (int)min_tile.x);
+        int min_y = std::max(0, (int)min_tile.y);
+        int max_x = std::min(size_x - 1, (int)max_tile.x);
+        int max_y = std::min(size_y - 1, (int)max_tile.y);
+        if (min_x > max_x || min_y > max_y)
         {
-            return;
+            return false;
         }
 
-        character_data::update();
-        update_hitbox();
-        update_sword();
+        // counting the valid positions a chunk at a time
+        int count = 0;
+        for (int chunk_y = min_y >> TILE_CHUNK_SHIFT; chunk_y <= max_y >> TILE_CHUNK_SHIFT; chunk_y++)
+        {
+            int first_y = std::max(min_y, chunk_y << TILE_CHUNK_SHIFT) & (TILE_CHUNK_SIZE - 1);
+            int last_y = std::min(max_y, ((chunk_y + 1) << TILE_CHUNK_SHIFT) - 1) & (TILE_CHUNK_SIZE - 1);
+            for (int chunk_x = min_x >> TILE_CHUNK_SHIFT; chunk_x <= max_x >> TILE_CHUNK_SHIFT; chunk_x++)
+            {
+                const unsigned int *rows = get_chunk_bits(fits, chunk_y * chunks_x + chunk_x);
+                unsigned int mask = get_row_mask(chunk_x, min_x, max_x);
+                for (int y = first_y; y <= last_y; y++)
+                {
+                    count += count_bits(rows[y] & mask);
+                }
+            }
+        }
+        if (count == 0)
+        {
+            return false;
+        }
 
-        if (is_attacking)
+        // choosing which of the valid positions to use, then finding it left to right, top to bottom (the chunks in the range are all built now)
+        int chosen = random.next_int(count);
+        for (int row = min_y;; row++)
         {
-            // if the player is attacking, update the attack cooldown and the attack state
-            update_attack_cooldown(delta_time);
-            // continue the attacking process
-            attacking();
+            const unsigned int *row_bits = &fits.rows[(((row >> TILE_CHUNK_SHIFT) * chunks_x) << TILE_CHUNK_SHIFT) + (row & (TILE_CHUNK_SIZE - 1))];
+            for (int chunk_x = min_x >> TILE_CHUNK_SHIFT; chunk_x <= max_x >> TILE_CHUNK_SHIFT; chunk_x++)
+            {
+                unsigned int word = row_bits[chunk_x << TILE_CHUNK_SHIFT] & get_row_mask(chunk_x, min_x, max_x);
+                int word_count = count_bits(word);
+                if (chosen >= word_count)
+                {
+                    chosen -= word_count;
+                    continue;
+                }
+
+                // clearing the lowest set bits before the chosen one
+                for (; chosen > 0; chosen--)
+                {
+                    word &= word - 1;
+                }
+                int bit = 0;
+                while ((word & (1u << bit)) == 0)
+                {
+                    bit++;
+                }
+                result = {(double)((chunk_x << TILE_CHUNK_SHIFT) + bit), (double)row};
+                return true;
+            }
         }
     }
 
-    // get the player's sword hitbox
-    const rectangle &get_hitbox() const
+    // make the free space table for a footprint size now instead of on the first query
+    // the tables are made lazily, so this must be called before the room is queried from more than one thread (their chunks are built under a lock)
+    void prepare_free_space(int width, int height) const
     {
-        return hitbox;
+        get_footprint_bits(width, height);
     }
 
-    void draw() const
+    // get the tile at the tile coordinates (color pattern index and passable bit)
+    tile_data get_tile(int x, int y) const
     {
+        return tiles->get(x, y);
+    }
 
-        // no need to draw if the player is dead
-        if (get_health() <= 0)
-        {
-            return;
-        }
-
-        character_data::draw();
-        draw_sword();
+    // drop the tile chunks used longest ago once more than max_resident_chunks are in memory
+    // must be called while nothing else uses the room, such as between updates
+    void trim_tiles()
+    {
+        tiles->trim(max_resident_chunks);
     }
-};
 
-// monster class, inherits from character_data, can disguise as npc (friendship with npc_data)
-class monster_data : public character_data
-{
-private:
-    // outline of the monster when disguised (or highlight)
-    bool show_outline;
+    // bytes used by the tiles, in memory and encoded
+    long long get_tile_memory() const
+    {
+        return tiles->get_memory_size();
+    }
 
-    // if the monster is exposed, it will be drawn, if not, the disguise will be drawn
-    bool expose_self;
+    int get_resident_chunk_count() const
+    {
+        return tiles->get_resident_count();
+    }
 
-    // the range at which the monster will detect the player
-    double player_detection_range;
-    bool escaped_player; // if the monster has escaped the player out of detection range, it is true, if not, it is false
+    int get_chunk_count() const
+    {
+        return tiles->get_chunk_count();
+    }
 
-    npc_data *disguise; // the npc object disguise of the monster
-    rectangle hitbox;   // the hitbox of the monster, the hitbox is active when the monster is exposed
+    // get the rectangle (in world pixels) of a tile, derived from the tile size
+    rectangle get_tile_rectangle(int x, int y) const
+    {
+        return {x * tile_size, y * tile_size, tile_size, tile_size};
+    }
 
-    // escape the player by moving away from the player
-    void escape_player(const player_data &player)
+    // getters and setters
+    const coordinate &get_spawn_coords() const
     {
-        // getting direction between the player and the monster
-        vector_2d direction = {0, 0};
-        direction.x = get_position().x - player.get_position().x;
-        direction.y = get_position().y - player.get_position().y;
+        return spawn_coords;
+    }
 
-        // the distance between the player and the monster, if the distance is greater than the player_detection_range, the monster has escaped the player
-        double distance = vector_magnitude(direction);
-        if (distance > player_detection_range)
+    int get_size_x() const
+    {
+        return size_x;
+    }
+
+    int get_size_y() const
+    {
+        return size_y;
+    }
+
+    double get_tile_size() const
+    {
+        return tile_size;
+    }
+
+    int get_walls_version() const
+    {
+        return walls_version;
+    }
+
+    const color *get_color_pattern() const
+    {
+        return color_pattern;
+    }
+
+    // sets the wall of the room, using a start and end tile coordinate
+    //(the wall is the rectangle from the top left corner of start tile to the bottom right corner of end tile)
+    void set_wall(const coordinate &start_tile, const coordinate &end_tile)
+    {
+        vector<coordinate> wall_coords_vector = {start_tile, end_tile};
+        walls_coords_vector.push_back(wall_coords_vector);
+
+        // writing the new wall into the floor
+        build_wall(wall_coords_vector);
+        floor_layer_outdated = true;
+        free_space_outdated = true;
+        walls_version++;
+    }
+
+    // the tiles only store the index of their color, so changing the pattern only changes these three colors
+    // the floor layer is re-rendered on the next draw only if one of them changed by a whole step of 8 bit color
+    void set_color_pattern(const color &floor_color_1, const color &floor_color_2, const color &wall_color)
+    {
+        color_pattern[0] = floor_color_1;
+        color_pattern[1] = floor_color_2;
+        color_pattern[2] = wall_color;
+    }
+};
+
+// distance (in tiles, scaled by 10) from every position of a footprint in the room to a source tile, going around walls
+// positions are the top left tile of the footprint, only the positions where the whole footprint fits are part of the map
+// the map is shared by every character of the footprint's size that chases (moves to lower distances) or flees (moves to higher distances) from the source
+class distance_map_data
+{
+private:
+    int size_x, size_y;
+    int footprint_width, footprint_height; // size of the characters using the map, in tiles
+    vector<int> distances;  // distance of each position to the source tile (row by row), INT_MAX if the footprint cannot reach the source
+    coordinate source_tile; // the tile the current distances are measured from
+
+    // the positions the footprint fits in, only built again when the room's walls change, so the searches only read this table
+    vector<unsigned char> open_tiles;
+    int open_size_x, open_size_y;
+    int open_walls_version; // walls version of the room the table was built for, -1 if it has not been built
+
+    // build the table of positions the footprint fits in if the room's walls changed, returns true if it was built
+    bool update_open_tiles(const room_data &room)
+    {
+        if (open_walls_version == room.get_walls_version() && open_size_x == room.get_size_x() && open_size_y == room.get_size_y())
         {
-            if (!escaped_player)
+            return false;
+        }
+
+        open_size_x = room.get_size_x();
+        open_size_y = room.get_size_y();
+        open_tiles.assign(open_size_x * open_size_y, 0);
+        for (int y = 0; y < open_size_y; y++)
+        {
+            for (int x = 0; x < open_size_x; x++)
             {
-                // this is to reset the disguise's position to activate the new position for npc object to automatically move to
-                // in the NPC class, if the new position is the same as the current position, the npc will get a random new position and move to it
-                disguise->set_new_position(get_position());
+                open_tiles[y * open_size_x + x] = room.is_area_passable(x, y, footprint_width, footprint_height);
             }
+        }
+        open_walls_version = room.get_walls_version();
+        return true;
+    }
 
-            escaped_player = true;
+    // Dijkstra from every position where the footprint covers the source tile, moving straight costs 10 and diagonally costs 14
+    static vector<int> calculate_distances(const vector<unsigned char> &open_tiles, int size_x, int size_y, coordinate source, int footprint_width, int footprint_height)
+    {
+        vector<int> result(size_x * size_y, INT_MAX);
+
+        // queue of (distance, tile index) with the smallest distance first
+        std::priority_queue<std::pair<int, int>, vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> open;
+        for (int y = (int)source.y - footprint_height + 1; y <= (int)source.y; y++)
+        {
+            for (int x = (int)source.x - footprint_width + 1; x <= (int)source.x; x++)
+            {
+                if (is_open(open_tiles, size_x, size_y, x, y))
+                {
+                    result[y * size_x + x] = 0;
+                    open.push({0, y * size_x + x});
+                }
+            }
+        }
+
+        while (!open.empty())
+        {
+            std::pair<int, int> current = open.top();
+            open.pop();
+            if (current.first > result[current.second])
+            {
+                continue; // already reached with a shorter distance
+            }
+
+            int x = current.second % size_x;
+            int y = current.second / size_x;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if ((dx == 0 && dy == 0) || !can_step(open_tiles, size_x, size_y, x, y, dx, dy))
+                    {
+                        continue;
+                    }
+
+                    int next_index = (y + dy) * size_x + (x + dx);
+                    int next_distance = current.first + ((dx != 0 && dy != 0) ? 14 : 10);
+                    if (next_distance < result[next_index])
+                    {
+                        result[next_index] = next_distance;
+                        open.push({next_distance, next_index});
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    static bool is_open(const vector<unsigned char> &open_tiles, int size_x, int size_y, int x, int y)
+    {
+        return x >= 0 && x < size_x && y >= 0 && y < size_y && open_tiles[y * size_x + x];
+    }
+
+    // check if a step to a neighbouring position is possible, diagonal steps cannot cut the corner of a blocked position
+    static bool can_step(const vector<unsigned char> &open_tiles, int size_x, int size_y, int x, int y, int dx, int dy)
+    {
+        if (!is_open(open_tiles, size_x, size_y, x + dx, y + dy))
+        {
+            return false;
+        }
+        return dx == 0 || dy == 0 || (is_open(open_tiles, size_x, size_y, x + dx, y) && is_open(open_tiles, size_x, size_y, x, y + dy));
+    }
+
+    // check a step with the finished distances, the footprint has to fit at both positions (they have distances)
+    bool can_step(int x, int y, int dx, int dy) const
+    {
+        if (get_distance(x + dx, y + dy) == INT_MAX)
+        {
+            return false;
+        }
+        return dx == 0 || dy == 0 || (get_distance(x + dx, y) != INT_MAX && get_distance(x, y + dy) != INT_MAX);
+    }
+
+public:
+    // Constructor, the map is for characters of footprint_width x footprint_height tiles
+    distance_map_data(int footprint_width = 1, int footprint_height = 1)
+    {
+        size_x = 0;
+        size_y = 0;
+        this->footprint_width = std::max(1, footprint_width);
+        this->footprint_height = std::max(1, footprint_height);
+        source_tile = {-1, -1};
+        open_size_x = 0;
+        open_size_y = 0;
+        open_walls_version = -1;
+    }
+
+    // measure the distances from the tile of a world position, the distances are only recalculated when the tile changes
+    // must be called in the game loop, the distances are measured on the calling thread so every run of a seed chases the same way
+    void update(const room_data &room, const coordinate &source_position)
+    {
+        coordinate tile = {floor(source_position.x / room.get_tile_size()), floor(source_position.y / room.get_tile_size())};
+        bool walls_changed = update_open_tiles(room);
+
+        if (tile.x != source_tile.x || tile.y != source_tile.y || walls_changed)
+        {
+            distances = calculate_distances(open_tiles, open_size_x, open_size_y, tile, footprint_width, footprint_height);
+            size_x = room.get_size_x();
+            size_y = room.get_size_y();
+            source_tile = tile;
+        }
+    }
+
+    // change the size of the characters using the map, the distances are measured again on the next update
+    void set_footprint(int width, int height)
+    {
+        footprint_width = std::max(1, width);
+        footprint_height = std::max(1, height);
+        source_tile = {-1, -1};
+        open_walls_version = -1;
+    }
+
+    // get the distance of a footprint position to the source tile, INT_MAX if the footprint does not fit there, cannot reach the source or the map is not ready
+    int get_distance(int x, int y) const
+    {
+        if (x < 0 || x >= size_x || y < 0 || y >= size_y)
+        {
+            return INT_MAX;
+        }
+        return distances[y * size_x + x];
+    }
+
+    // find the position on the map nearest to a tile (in steps, up to the footprint's size away), returns false if there is none
+    bool find_nearest_position(int x, int y, int &result_x, int &result_y) const
+    {
+        int radius = std::max(footprint_width, footprint_height);
+        int nearest = INT_MAX;
+        for (int dy = -radius; dy <= radius; dy++)
+        {
+            for (int dx = -radius; dx <= radius; dx++)
+            {
+                int steps = std::max(std::abs(dx), std::abs(dy));
+                if (steps < nearest && get_distance(x + dx, y + dy) != INT_MAX)
+                {
+                    nearest = steps;
+                    result_x = x + dx;
+                    result_y = y + dy;
+                }
+            }
+        }
+        return nearest != INT_MAX;
+    }
+
+    // get the direction (not a unit vector) from the top left corner of a footprint (world position) to the neighbouring position that is closer
+    // to the source (towards is true) or further from the source (towards is false), returns {0, 0} if there is no better position to move to
+    // the direction leads to the top left corner of the chosen tile, so the footprint lines up with the tiles it moves through
+    vector_2d get_direction(const room_data &room, const coordinate &position, bool towards) const
+    {
+        double tile_size = room.get_tile_size();
+        int x = (int)floor(position.x / tile_size);
+        int y = (int)floor(position.y / tile_size);
+        int current = get_distance(x, y);
+        if (current == INT_MAX)
+        {
+            return {0, 0};
+        }
+
+        int best = current;
+        int best_dx = 0, best_dy = 0;
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx == 0 && dy == 0) || !can_step(x, y, dx, dy))
+                {
+                    continue;
+                }
+
+                int distance = get_distance(x + dx, y + dy);
+                if ((towards && distance < best) || (!towards && distance != INT_MAX && distance > best))
+                {
+                    best = distance;
+                    best_dx = dx;
+                    best_dy = dy;
+                }
+            }
+        }
+
+        if (best_dx == 0 && best_dy == 0)
+        {
+            return {0, 0};
+        }
+
+        // heading to the top left corner of the chosen tile
+        return {(x + best_dx) * tile_size - position.x, (y + best_dy) * tile_size - position.y};
+    }
+};
+
+// a path request waiting in the path finder's queue
+struct path_request_data
+{
+    int ticket;                    // used to collect the path once it is found
+    coordinate start, goal;        // tile coordinates (top left tile of the footprint)
+    int footprint_width;           // size of the character in tiles
+    int footprint_height;
+};
+
+// a finished path request, the path is a list of tile coordinates from the start to the goal (without the start tile)
+struct path_result_data
+{
+    bool found;
+    vector<coordinate> path;
+};
+
+// hierarchical path finder (HPA*) over the room's tiles
+// the room is split into square clusters, the tiles where neighbouring clusters connect become nodes of an abstract graph,
+// paths are found on the abstract graph first and then refined into tiles inside each cluster
+// requests are queued and processed with a time budget each frame, so many characters can ask for paths without frame spikes
+class path_finder_data
+{
+private:
+    const room_data *room;
+    int cluster_size;
+    int clusters_x, clusters_y;
+
+    // the abstraction is built for one footprint size, and rebuilt when the footprint or the room's walls change
+    int footprint_width, footprint_height;
+    int walls_version;
+    int size_x, size_y;
+    vector<unsigned char> open_tiles; // 1 if the footprint fits with its top left corner at the tile
+
+    // abstract graph, nodes are tiles on the borders of clusters, edges are (node, cost)
+    vector<int> node_tiles;                      // tile index of each node
+    vector<vector<std::pair<int, int>>> edges;   // edges of each node
+    vector<vector<int>> cluster_nodes;           // nodes inside each cluster
+    vector<int> node_at_tile;                    // node of each tile, -1 if the tile is not a node
+
+    // reusable buffers for the searches, a search stamp marks which entries belong to the current search
+    vector<int> tile_cost, tile_parent, tile_stamp;
+    vector<int> node_cost, node_parent, node_stamp, goal_link_cost;
+    int search_stamp;
+
+    // queue of requests and the finished results waiting to be collected
+    std::deque<path_request_data> requests;
+    std::unordered_map<int, path_result_data> results;
+    int next_ticket;
+
+    // statistics of the last call to process_requests
+    int frame_query_count;
+    double frame_query_time; // ms
+
+    int get_cluster(int tile_index) const
+    {
+        int x = tile_index % size_x;
+        int y = tile_index / size_x;
+        return (y / cluster_size) * clusters_x + (x / cluster_size);
+    }
+
+    // tile bounds of a cluster (end is excluded)
+    void get_cluster_bounds(int cluster, int &start_x, int &start_y, int &end_x, int &end_y) const
+    {
+        start_x = (cluster % clusters_x) * cluster_size;
+        start_y = (cluster / clusters_x) * cluster_size;
+        end_x = std::min(size_x, start_x + cluster_size);
+        end_y = std::min(size_y, start_y + cluster_size);
+    }
+
+    // octile distance between two tiles, used as the A* heuristic (straight is 10, diagonal is 14)
+    int estimate_cost(int from, int to) const
+    {
+        int dx = std::abs(from % size_x - to % size_x);
+        int dy = std::abs(from / size_x - to / size_x);
+        return 10 * std::max(dx, dy) + 4 * std::min(dx, dy);
+    }
+
+    bool is_open(int x, int y) const
+    {
+        return x >= 0 && x < size_x && y >= 0 && y < size_y && open_tiles[y * size_x + x];
+    }
+
+    // diagonal steps cannot cut the corner of a blocked tile
+    bool can_step(int x, int y, int dx, int dy) const
+    {
+        return is_open(x + dx, y + dy) && (dx == 0 || dy == 0 || (is_open(x + dx, y) && is_open(x, y + dy)));
+    }
+
+    // A* (or Dijkstra when goal is -1) from a tile, only visiting tiles inside the cluster
+    // returns the cost to the goal, or -1 if it is not reachable, costs of all visited tiles are left in tile_cost
+    int search_cluster(int start, int goal, int cluster)
+    {
+        int start_x, start_y, end_x, end_y;
+        get_cluster_bounds(cluster, start_x, start_y, end_x, end_y);
+
+        search_stamp++;
+        std::priority_queue<std::pair<int, int>, vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> open;
+        tile_cost[start] = 0;
+        tile_parent[start] = -1;
+        tile_stamp[start] = search_stamp;
+        open.push({goal == -1 ? 0 : estimate_cost(start, goal), start});
+
+        while (!open.empty())
+        {
+            int current = open.top().second;
+            int current_cost = open.top().first - (goal == -1 ? 0 : estimate_cost(current, goal));
+            open.pop();
+            if (current_cost > tile_cost[current])
+            {
+                continue; // already reached with a lower cost
+            }
+            if (current == goal)
+            {
+                return tile_cost[current];
+            }
+
+            int x = current % size_x;
+            int y = current / size_x;
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int next_x = x + dx, next_y = y + dy;
+                    if ((dx == 0 && dy == 0) || next_x < start_x || next_x >= end_x || next_y < start_y || next_y >= end_y || !can_step(x, y, dx, dy))
+                    {
+                        continue;
+                    }
+
+                    int next = next_y * size_x + next_x;
+                    int next_cost = tile_cost[current] + ((dx != 0 && dy != 0) ? 14 : 10);
+                    if (tile_stamp[next] != search_stamp || next_cost < tile_cost[next])
+                    {
+                        tile_stamp[next] = search_stamp;
+                        tile_cost[next] = next_cost;
+                        tile_parent[next] = current;
+                        open.push({next_cost + (goal == -1 ? 0 : estimate_cost(next, goal)), next});
+                    }
+                }
+            }
+        }
+
+        return -1;
+    }
+
+    // add the tiles of the last search_cluster from the start to the goal onto the end of the path (without the start tile)
+    void append_search_path(int goal, vector<coordinate> &path)
+    {
+        int count = 0;
+        for (int tile = goal; tile_parent[tile] != -1; tile = tile_parent[tile])
+        {
+            count++;
+        }
+
+        path.resize(path.size() + count);
+        int i = path.size() - 1;
+        for (int tile = goal; tile_parent[tile] != -1; tile = tile_parent[tile])
+        {
+            path[i--] = {(double)(tile % size_x), (double)(tile / size_x)};
+        }
+    }
+
+    // get the node of a tile, creating it if the tile is not a node yet
+    int add_node(int tile)
+    {
+        if (node_at_tile[tile] == -1)
+        {
+            node_at_tile[tile] = node_tiles.size();
+            node_tiles.push_back(tile);
+            edges.push_back({});
+            cluster_nodes[get_cluster(tile)].push_back(node_at_tile[tile]);
+        }
+        return node_at_tile[tile];
+    }
+
+    // connect two neighbouring tiles in different clusters
+    void add_entrance(int tile_a, int tile_b)
+    {
+        int node_a = add_node(tile_a);
+        int node_b = add_node(tile_b);
+        edges[node_a].push_back({node_b, 10});
+        edges[node_b].push_back({node_a, 10});
+    }
+
+    // find the entrances on the border between two clusters, the border is given by the first tile pair and the step along it
+    // an entrance is made in the middle of each open part of the border, or at both ends if the open part is long
+    void add_border_entrances(int x, int y, int other_dx, int other_dy, int step_x, int step_y, int length)
+    {
+        int run_start = -1;
+        for (int i = 0; i <= length; i++)
+        {
+            int tile_x = x + step_x * i, tile_y = y + step_y * i;
+            bool open = i < length && is_open(tile_x, tile_y) && is_open(tile_x + other_dx, tile_y + other_dy);
+
+            if (open && run_start == -1)
+            {
+                run_start = i;
+            }
+            if (!open && run_start != -1)
+            {
+                int run_end = i - 1;
+                vector<int> picks;
+                if (run_end - run_start + 1 >= 6)
+                    picks = {run_start, run_end};
+                else
+                    picks = {(run_start + run_end) / 2};
+
+                for (int j = 0; j < picks.size(); j++)
+                {
+                    int a = (y + step_y * picks[j]) * size_x + (x + step_x * picks[j]);
+                    int b = (y + step_y * picks[j] + other_dy) * size_x + (x + step_x * picks[j] + other_dx);
+                    add_entrance(a, b);
+                }
+                run_start = -1;
+            }
+        }
+    }
+
+    // build the abstract graph for a footprint size
+    void build(int footprint_width, int footprint_height)
+    {
+        this->footprint_width = footprint_width;
+        this->footprint_height = footprint_height;
+        walls_version = room->get_walls_version();
+        size_x = room->get_size_x();
+        size_y = room->get_size_y();
+        clusters_x = (size_x + cluster_size - 1) / cluster_size;
+        clusters_y = (size_y + cluster_size - 1) / cluster_size;
+
+        open_tiles.assign(size_x * size_y, 0);
+        for (int y = 0; y < size_y; y++)
+        {
+            for (int x = 0; x < size_x; x++)
+            {
+                open_tiles[y * size_x + x] = room->is_area_passable(x, y, footprint_width, footprint_height);
+            }
+        }
+
+        tile_cost.assign(size_x * size_y, 0);
+        tile_parent.assign(size_x * size_y, -1);
+        tile_stamp.assign(size_x * size_y, 0);
+        search_stamp = 0;
+
+        node_tiles.clear();
+        edges.clear();
+        node_at_tile.assign(size_x * size_y, -1);
+        cluster_nodes.assign(clusters_x * clusters_y, {});
+
+        // entrances between neighbouring clusters
+        for (int cy = 0; cy < clusters_y; cy++)
+        {
+            for (int cx = 0; cx < clusters_x; cx++)
+            {
+                int start_y = cy * cluster_size;
+                int start_x = cx * cluster_size;
+                int height = std::min(cluster_size, size_y - start_y);
+                int width = std::min(cluster_size, size_x - start_x);
+
+                // border with the cluster on the right
+                if (cx + 1 < clusters_x)
+                    add_border_entrances(start_x + cluster_size - 1, start_y, 1, 0, 0, 1, height);
+                // border with the cluster below
+                if (cy + 1 < clusters_y)
+                    add_border_entrances(start_x, start_y + cluster_size - 1, 0, 1, 1, 0, width);
+            }
+        }
+
+        // connecting the nodes inside each cluster with the cost of the path between them
+        for (int cluster = 0; cluster < cluster_nodes.size(); cluster++)
+        {
+            const vector<int> &nodes = cluster_nodes[cluster];
+            for (int i = 0; i < nodes.size(); i++)
+            {
+                search_cluster(node_tiles[nodes[i]], -1, cluster);
+                for (int j = 0; j < nodes.size(); j++)
+                {
+                    int tile = node_tiles[nodes[j]];
+                    if (i != j && tile_stamp[tile] == search_stamp)
+                    {
+                        edges[nodes[i]].push_back({nodes[j], tile_cost[tile]});
+                    }
+                }
+            }
+        }
+
+        int node_count = node_tiles.size();
+        node_cost.assign(node_count + 2, 0);
+        node_parent.assign(node_count + 2, -1);
+        node_stamp.assign(node_count + 2, 0);
+        goal_link_cost.assign(node_count + 2, -1);
+    }
+
+    // find a path between two tiles, the path is written into result
+    void find_path(const path_request_data &request, path_result_data &result)
+    {
+        result.path.clear();
+        result.found = false;
+
+        int start = (int)request.start.y * size_x + (int)request.start.x;
+        int goal = (int)request.goal.y * size_x + (int)request.goal.x;
+        if (!is_open((int)request.start.x, (int)request.start.y) || !is_open((int)request.goal.x, (int)request.goal.y))
+        {
+            return;
+        }
+        if (start == goal)
+        {
+            result.found = true;
+            return;
+        }
+
+        int start_cluster = get_cluster(start);
+        int goal_cluster = get_cluster(goal);
+
+        // paths inside one cluster are searched directly
+        if (start_cluster == goal_cluster && search_cluster(start, goal, start_cluster) != -1)
+        {
+            append_search_path(goal, result.path);
+            result.found = true;
             return;
         }
 
-        // if the monster has not escapted the player, it will move away from the player
-        escaped_player = false;
-        if (direction.x != 0 || direction.y != 0)
+        // linking the start and goal to the nodes of their clusters, the start is node_count and the goal is node_count + 1
+        int node_count = node_tiles.size();
+        int start_node = node_count, goal_node = node_count + 1;
+        const vector<int> &goal_cluster_nodes = cluster_nodes[goal_cluster];
+        search_cluster(goal, -1, goal_cluster);
+        for (int i = 0; i < goal_cluster_nodes.size(); i++)
+        {
+            int tile = node_tiles[goal_cluster_nodes[i]];
+            goal_link_cost[goal_cluster_nodes[i]] = tile_stamp[tile] == search_stamp ? tile_cost[tile] : -1;
+        }
+
+        vector<std::pair<int, int>> start_links;
+        const vector<int> &start_cluster_nodes = cluster_nodes[start_cluster];
+        search_cluster(start, -1, start_cluster);
+        for (int i = 0; i < start_cluster_nodes.size(); i++)
+        {
+            int tile = node_tiles[start_cluster_nodes[i]];
+            if (tile_stamp[tile] == search_stamp)
+            {
+                start_links.push_back({start_cluster_nodes[i], tile_cost[tile]});
+            }
+        }
+
+        // A* over the abstract graph
+        search_stamp++;
+        std::priority_queue<std::pair<int, int>, vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> open;
+        node_cost[start_node] = 0;
+        node_parent[start_node] = -1;
+        node_stamp[start_node] = search_stamp;
+        open.push({estimate_cost(start, goal), start_node});
+        bool reached = false;
+
+        while (!open.empty())
+        {
+            int current = open.top().second;
+            int current_tile = current == start_node ? start : node_tiles[current];
+            int current_cost = open.top().first - estimate_cost(current_tile, goal);
+            open.pop();
+            if (current_cost > node_cost[current])
+            {
+                continue;
+            }
+            if (current == goal_node)
+            {
+                reached = true;
+                break;
+            }
+
+            const vector<std::pair<int, int>> &links = current == start_node ? start_links : edges[current];
+            for (int i = 0; i <= links.size(); i++)
+            {
+                int next, cost;
+                if (i < links.size())
+                {
+                    next = links[i].first;
+                    cost = links[i].second;
+                }
+                else if (current != start_node && get_cluster(node_tiles[current]) == goal_cluster && goal_link_cost[current] != -1)
+                {
+                    next = goal_node;
+                    cost = goal_link_cost[current];
+                }
+                else
+                {
+                    continue;
+                }
+
+                int next_cost = node_cost[current] + cost;
+                if (node_stamp[next] != search_stamp || next_cost < node_cost[next])
+                {
+                    node_stamp[next] = search_stamp;
+                    node_cost[next] = next_cost;
+                    node_parent[next] = current;
+                    int next_tile = next == goal_node ? goal : node_tiles[next];
+                    open.push({next_cost + estimate_cost(next_tile, goal), next});
+                }
+            }
+        }
+
+        for (int i = 0; i < goal_cluster_nodes.size(); i++)
+        {
+            goal_link_cost[goal_cluster_nodes[i]] = -1;
+        }
+
+        if (!reached)
+        {
+            return;
+        }
+
+        // the abstract path from the start to the goal (as tiles)
+        vector<int> abstract_tiles;
+        for (int node = goal_node; node != -1; node = node_parent[node])
+        {
+            abstract_tiles.push_back(node == goal_node ? goal : (node == start_node ? start : node_tiles[node]));
+        }
+        std::reverse(abstract_tiles.begin(), abstract_tiles.end());
+
+        // refining each step of the abstract path into tiles, steps are either inside one cluster or to the neighbouring tile
+        for (int i = 0; i + 1 < abstract_tiles.size(); i++)
+        {
+            int from = abstract_tiles[i], to = abstract_tiles[i + 1];
+            if (get_cluster(from) != get_cluster(to))
+            {
+                result.path.push_back({(double)(to % size_x), (double)(to / size_x)});
+            }
+            else if (from != to && search_cluster(from, to, get_cluster(from)) != -1)
+            {
+                append_search_path(to, result.path);
+            }
+        }
+
+        simplify_path(result.path);
+        result.found = true;
+    }
+
+    // remove the tiles in the middle of straight lines, so the path only keeps the tiles where it turns
+    static void simplify_path(vector<coordinate> &path)
+    {
+        if (path.size() < 3)
+        {
+            return;
+        }
+
+        int kept = 1;
+        for (int i = 1; i + 1 < path.size(); i++)
+        {
+            double dx1 = path[i].x - path[kept - 1].x, dy1 = path[i].y - path[kept - 1].y;
+            double dx2 = path[i + 1].x - path[i].x, dy2 = path[i + 1].y - path[i].y;
+            bool same_direction = dx1 * dy2 == dy1 * dx2 && dx1 * dx2 >= 0 && dy1 * dy2 >= 0;
+            if (!same_direction)
+            {
+                path[kept++] = path[i];
+            }
+        }
+        path[kept++] = path.back();
+        path.resize(kept);
+    }
+
+public:
+    // Constructor, clusters are cluster_size x cluster_size tiles
+    path_finder_data(const room_data &room, int cluster_size = 10)
+    {
+        this->room = &room;
+        this->cluster_size = cluster_size;
+        footprint_width = 0;
+        footprint_height = 0;
+        walls_version = -1;
+        size_x = 0;
+        size_y = 0;
+        clusters_x = 0;
+        clusters_y = 0;
+        search_stamp = 0;
+        next_ticket = 0;
+        frame_query_count = 0;
+        frame_query_time = 0;
+    }
+
+    // queue a path request from the start tile to the goal tile for a character of footprint_width x footprint_height tiles
+    // returns a ticket to collect the path with take_path
+    int request_path(const coordinate &start_tile, const coordinate &goal_tile, int footprint_width, int footprint_height)
+    {
+        path_request_data request = {next_ticket++, start_tile, goal_tile, footprint_width, footprint_height};
+        requests.push_back(request);
+        return request.ticket;
+    }
+
+    // forget a request that is no longer needed, whether or not it has been processed
+    void cancel_path(int ticket)
+    {
+        results.erase(ticket);
+        for (int i = 0; i < requests.size(); i++)
+        {
+            if (requests[i].ticket == ticket)
+            {
+                requests.erase(requests.begin() + i);
+                return;
+            }
+        }
+    }
+
+    // collect a processed path, returns false if the request has not been processed yet
+    // found is false if there is no path, otherwise path holds the tiles to walk through (the last one is the goal)
+    bool take_path(int ticket, vector<coordinate> &path, bool &found)
+    {
+        // requests are processed in order, so any ticket from the front of the queue onwards is still waiting
+        if (!requests.empty() && ticket >= requests.front().ticket)
+        {
+            return false;
+        }
+
+        auto result = results.find(ticket);
+        if (result == results.end())
+        {
+            return false;
+        }
+
+        found = result->second.found;
+        path.swap(result->second.path);
+        results.erase(result);
+        return true;
+    }
+
+    // process queued requests until the time budget (ms) runs out, at least one request is processed each call
+    // must be called in the game loop
+    void process_requests(double budget)
+    {
+        TRACE_ZONE("path finder");
+        auto start_time = std::chrono::steady_clock::now();
+        frame_query_count = 0;
+        frame_query_time = 0;
+
+        while (!requests.empty())
+        {
+            path_request_data request = requests.front();
+            requests.pop_front();
+
+            if (request.footprint_width != footprint_width || request.footprint_height != footprint_height || room->get_walls_version() != walls_version)
+            {
+                build(request.footprint_width, request.footprint_height);
+            }
+
+            find_path(request, results[request.ticket]);
+            frame_query_count++;
+
+            frame_query_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+            if (frame_query_time >= budget)
+            {
+                break;
+            }
+        }
+    }
+
+    // number of requests processed by the last process_requests call
+    int get_frame_query_count() const
+    {
+        return frame_query_count;
+    }
+
+    // time spent (ms) by the last process_requests call
+    double get_frame_query_time() const
+    {
+        return frame_query_time;
+    }
+};
+
+class character_data
+{
+private:
+    int health;
+    double speed; // pixels per second
+
+    rectangle hurtbox; // the box that determines the player's collision
+    sprite_data character_model;
+    bool model_facing_right; // models are drawn facing right, this is used to determine if the model should be flipped
+    double model_scaling;    // scaling of the model, character model is scaled by this value (character model is made at 5x10 pixels)
+
+    coordinate position;          // position of the character in the room (world pixels, zoom is only applied when drawing)
+    coordinate previous_position; // position before the current update, the character is drawn between the two
+
+protected:
+    // constructor
+    character_data(int health, double speed, const sprite_data &model, bool model_facing_right, double model_size, const coordinate &spawn_coords)
+    {
+        // setting player
+        character_model = model;
+        this->model_facing_right = model_facing_right; // depending on the drawn model, the player might be facing right or left
+        this->health = health;
+        this->speed = speed; // pixels per milisecond
+
+        // setting the model size, calculated by the smallest side of the model
+        set_model_size(model_size);
+
+        position = {spawn_coords.x, spawn_coords.y};
+        previous_position = position;
+
+        // setting the hurtbox
+        update_hurtbox();
+    }
+
+    // update the position of the hurtbox as the character moves (align with character's position)
+    void update_hurtbox()
+    {
+        double model_width = character_model.width;
+        double model_height = character_model.height;
+        hurtbox = {position.x, position.y, model_width * model_scaling, model_height * model_scaling};
+    }
+
+    // getters and setters
+    // set the size of the model (scaling of the model), the smallest side will be scaled to the model_size
+    void set_model_size(double model_size)
+    {
+        model_scaling = character_model.get_scaling(model_size);
+    }
+
+    // return the model (sprite) of the character
+    const sprite_data &get_model() const
+    {
+        return character_model;
+    }
+
+    // get the direction the character is facing (direction of the model)
+    bool get_is_facing_right() const
+    {
+        return model_facing_right;
+    }
+
+    // get the scaling of the model
+    double get_model_scaling() const
+    {
+        return model_scaling;
+    }
+
+    void set_position(const coordinate &position)
+    {
+        this->position = position;
+    }
+
+    void set_health(int health)
+    {
+        this->health = health;
+    }
+
+public:
+    // update the character's position and hurtbox, should always be ran inside the game loop
+    void update()
+    {
+        // no need to update if the character is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        update_hurtbox();
+    }
+
+    // move the character in a direction by a distance
+    void move(vector_2d &direction, double distance, const room_data &room)
+    {
+        if (direction.x != 0 || direction.y != 0)
+        {
+            direction = unit_vector(direction); // convert to unit vector
+        }
+
+        vector_2d movement = vector_multiply(direction, distance);
+
+        // sweeping the hurtbox (at the current position) through the room's tiles, stopping it at the walls
+        rectangle box = {position.x, position.y, hurtbox.width, hurtbox.height};
+        movement = room.sweep_box(box, movement);
+
+        coordinate new_position = {position.x + movement.x, position.y + movement.y};
+        set_position(new_position);
+        update_hurtbox();
+    }
+
+    // keep the position before an update, must be called before each update
+    void save_previous_position()
+    {
+        previous_position = position;
+    }
+
+    // get the position to draw the character at, interpolation is how far the clock is between the last update and the next (0 to 1)
+    coordinate get_drawn_position(double interpolation) const
+    {
+        return {previous_position.x + (position.x - previous_position.x) * interpolation, previous_position.y + (position.y - previous_position.y) * interpolation};
+    }
+
+    // add the character to the sprite batch, zoomed by the camera
+    void draw(const camera_data &camera, sprite_batch_data &batch, double interpolation = 1) const
+    {
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        double zoomed_model_scaling = get_model_scaling() * camera.get_zoom_level();
+        coordinate zoomed_position = camera.get_zoomed(get_drawn_position(interpolation));
+
+        // flip when facing opposite direction
+        batch.add(get_model(), zoomed_position.x, zoomed_position.y, zoomed_model_scaling, !get_is_facing_right());
+    }
+
+    // check if the character's hurtbox is colliding with a hitbox
+    void check_hitbox_collision(const rectangle &hitbox)
+    {
+        rectangle collision_box = intersection(hurtbox, hitbox);
+        if (collision_box.width != 0 && collision_box.height != 0)
+        {
+            // if there is a collision, decrease the health of the character
+            health--;
+        }
+    }
+    // getters and setters
+    double get_speed() const
+    {
+        return speed;
+    }
+
+    int get_health() const
+    {
+        return health;
+    }
+
+    const coordinate &get_position() const
+    {
+        return position;
+    }
+
+    // set the direction the character is facing (true is right, false is left)
+    void set_is_facing_right(bool facing_right)
+    {
+        model_facing_right = facing_right;
+    }
+
+    // get the character's center position in the room
+    coordinate get_center_position() const
+    {
+        return {position.x + (get_model().width * get_model_scaling()) / 2, position.y + (get_model().height * get_model_scaling()) / 2};
+    }
+
+    // get the hurtbox of the character
+    const rectangle &get_hurtbox() const
+    {
+        return hurtbox;
+    }
+
+    // get the size of the character in tiles (the tiles the character covers when it is aligned with the tiles)
+    void get_tile_footprint(const room_data &room, int &width, int &height) const
+    {
+        width = (int)ceil(get_hurtbox().width / room.get_tile_size());
+        height = (int)ceil(get_hurtbox().height / room.get_tile_size());
+    }
+};
+
+// class for npcs in the game
+class npc_data : public character_data
+{
+private:
+    coordinate new_position; // the position the npc is moving to
+
+    double auto_move_max_distance; // the range at which the new_position can be from its current position (in a square)
+
+    int time_since_new_position; // the time since the npc has a new position
+    int new_position_cooldown;   // the time the npc should have a new position
+
+    vector<coordinate> path; // tiles to walk through to get to the new position, empty if the npc moves straight to it
+    int path_index;          // the tile in the path the npc is currently moving to
+    int path_ticket;         // ticket of the path requested from the path finder, -1 if there is no request waiting
+    int expired_ticket;      // ticket of a request that is no longer needed, cancelled on the next update
+
+    random_stream_data random; // picks the new positions
+
+    // generates a random position for the npc, that is valid for the npc to move to, or stay at
+    void update_new_position(const room_data &room, coordinate min_coords, coordinate max_coords)
+    {
+        min_coords = min_coords.pixel_to_tile(room.get_tile_size());
+        max_coords = max_coords.pixel_to_tile(room.get_tile_size());
+
+        // the size of the npc in tiles, the npc must fit inside the new position
+        int player_tile_width, player_tile_height;
+        get_tile_footprint(room, player_tile_width, player_tile_height);
+
+        // picking from the positions the npc fits in, if there are none in range any position in the room is used
+        coordinate rand_position;
+        coordinate room_max = {(double)(room.get_size_x() - 1), (double)(room.get_size_y() - 1)};
+        if (!room.random_free_position(player_tile_width, player_tile_height, min_coords, max_coords, rand_position, random) &&
+            !room.random_free_position(player_tile_width, player_tile_height, {0, 0}, room_max, rand_position, random))
+        {
+            // the npc does not fit anywhere, so it stays where it is
+            rand_position = get_position().pixel_to_tile(room.get_tile_size());
+        }
+
+        set_new_position(rand_position);
+    }
+
+    // move the npc to a random position within a range automatically, the path to it is requested from the path finder
+    void auto_set_new_position(double delta_time, const room_data &room, path_finder_data &path_finder)
+    {
+        coordinate position = get_position();
+
+        // determines if NPC is at the destination, allows an error of (+-)10 pixel due to the float to int conversion, and other scalings
+        bool x_at_destination = ((int)position.x >= new_position.x - 10) && ((int)position.x <= new_position.x + 10);
+        bool y_at_destination = ((int)position.y >= new_position.y - 10) && ((int)position.y <= new_position.y + 10);
+
+        time_since_new_position += delta_time;
+        bool cooldown_passed = time_since_new_position >= new_position_cooldown;
+
+        // if the npc is at the destination or cooldown for new position passed, generate a new destination
+        if ((x_at_destination && y_at_destination) || cooldown_passed)
+        {
+            coordinate min_coords = {get_position().x - auto_move_max_distance, get_position().y - auto_move_max_distance};
+            coordinate max_coords = {get_position().x + auto_move_max_distance, get_position().y + auto_move_max_distance};
+
+            update_new_position(room, min_coords, max_coords);
+
+            coordinate new_tile = new_position;
+            new_position = new_position.tile_to_pixel(room.get_tile_size()); // converting back to pixel coordinates for the npc to move to
+            time_since_new_position = 0;
+
+            // the path starts from the tile the npc's top left corner is in
+            int footprint_width, footprint_height;
+            get_tile_footprint(room, footprint_width, footprint_height);
+            coordinate start_tile = {floor(get_position().x / room.get_tile_size()), floor(get_position().y / room.get_tile_size())};
+            path_ticket = path_finder.request_path(start_tile, new_tile, footprint_width, footprint_height);
+        }
+    }
+
+    // get the position the npc should be heading to now, the next tile of the path or the new position
+    // returns false if the npc is still waiting for its path
+    bool get_move_target(double distance, const room_data &room, path_finder_data &path_finder, coordinate &target)
+    {
+        if (path_ticket != -1)
+        {
+            bool found;
+            if (!path_finder.take_path(path_ticket, path, found))
+            {
+                return false;
+            }
+
+            // without a path the npc moves straight to the new position
+            if (!found)
+            {
+                path.clear();
+            }
+            path_index = 0;
+            path_ticket = -1;
+        }
+
+        // skipping the tiles of the path that are reached
+        while (path_index < path.size())
+        {
+            coordinate tile_position = path[path_index].tile_to_pixel(room.get_tile_size());
+            vector_2d difference = {tile_position.x - get_position().x, tile_position.y - get_position().y};
+            if (vector_magnitude(difference) > distance || path_index + 1 == path.size())
+            {
+                target = tile_position;
+                return true;
+            }
+            path_index++;
+        }
+
+        target = new_position;
+        return true;
+    }
+
+    void auto_move(double delta_time, const room_data &room, path_finder_data &path_finder)
+    {
+        // the distance the npc should move according to delta_time
+        double distance = get_speed() * (double)delta_time;
+
+        // waiting for the path finder before moving
+        coordinate target;
+        if (!get_move_target(distance, room, path_finder, target))
+        {
+            return;
+        }
+
+        // calculate the direction and distance the npc should move
+        vector_2d direction = {0, 0};
+        direction.x = target.x - get_position().x;
+        direction.y = target.y - get_position().y;
+
+        // set the direction the npc is facing
+        if (direction.x > 0)
+        {
+            set_is_facing_right(true);
+        }
+        else
+        {
+            set_is_facing_right(false);
+        }
+
+        // not moving past the target
+        distance = std::min(distance, vector_magnitude(direction));
+
+        move(direction, distance, room);
+    }
+
+    // setting new position of the npc (that it will auto move to), the npc moves straight to it until a path is requested
+    void set_new_position(const coordinate &new_position)
+    {
+        this->new_position = new_position;
+        path.clear();
+        path_index = 0;
+
+        // any request still waiting is cancelled on the next update
+        if (path_ticket != -1)
+        {
+            expired_ticket = path_ticket;
+            path_ticket = -1;
+        }
+    }
+
+public:
+    // Constructor
+    npc_data(double tile_size, double model_size, const room_data &room, const sprite_data &model, unsigned long long seed)
+        : character_data(1, 4 * tile_size / 1000, model, true, model_size, {0, 0}), random(seed)
+    {
+        auto_move_max_distance = 10 * tile_size;
+        new_position_cooldown = 5000; // ms
+        time_since_new_position = 0;  // ms
+        path_index = 0;
+        path_ticket = -1;
+        expired_ticket = -1;
+
+        coordinate max = {(double)(room.get_size_x() - 1), (double)(room.get_size_y() - 1)};
+        coordinate min = {0, 0};
+        update_new_position(room, min.tile_to_pixel(room.get_tile_size()), max.tile_to_pixel(room.get_tile_size()));
+
+        new_position = new_position.tile_to_pixel(room.get_tile_size());
+
+        set_position(new_position);
+    }
+
+    // update the npc's position and hurtbox, should always be ran inside the game loop
+    // paths requested from the path finder are collected on later updates, after the path finder processes them
+    void update(double delta_time, const room_data &room, path_finder_data &path_finder)
+    {
+        // no need to update if the npc is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        if (expired_ticket != -1)
+        {
+            path_finder.cancel_path(expired_ticket);
+            expired_ticket = -1;
+        }
+
+        auto_set_new_position(delta_time, room, path_finder);
+
+        auto_move(delta_time, room, path_finder);
+
+        // calls update from character_data base class, updates hitbox and model scaling
+        character_data::update();
+    }
+
+    void set_health(int health)
+    {
+        character_data::set_health(health);
+    }
+
+    // friends with monster_data to allow monster_data to access npc_data's private members (used as disguise)
+    friend class monster_data;
+};
+
+// path request made by an npc during the parallel part of the update, sent to the path finder afterwards
+struct npc_path_request_data
+{
+    int npc;
+    int old_ticket; // request to cancel, -1 if there is none
+    coordinate start_tile;
+    coordinate goal_tile;
+};
+
+// storage for the crowd of npcs, kept as a struct of arrays so each step of the update streams through packed arrays
+// every npc in the store uses the same model, so the model, size, speed and timings are shared
+// the hurtbox of each npc is its position with the shared hurtbox size
+class npc_store_data
+{
+private:
+    static const int CHUNK_SIZE = 256; // npcs updated by one job, fixed so the results do not depend on the number of threads
+    static const int WAITING_FOR_REQUEST = -2; // path_ticket of an npc whose path request has not been sent yet
+
+    int count;
+
+    // data read and written every update
+    vector<double> position_x, position_y;               // top left of each npc (world pixels)
+    vector<double> velocity_x, velocity_y;               // movement of each npc for the current update (pixels)
+    vector<double> target_x, target_y;                   // the point each npc is heading to (the next tile of its path, or its destination)
+    vector<double> time_since_new_position;              // ms
+    vector<int> health;
+    vector<unsigned char> facing_right;
+
+    // data only used when the destination or the path changes
+    vector<double> destination_x, destination_y;         // the position each npc is moving to
+    vector<int> path_ticket;                             // path request waiting in the path finder, -1 if there is none
+    vector<int> path_index;                              // the tile of the path each npc is heading to
+    vector<vector<coordinate>> paths;                    // tiles to walk through to get to the destination
+
+    // data only used when drawing
+    vector<double> previous_x, previous_y;               // position before the current update, the npcs are drawn between the two
+
+    // shared by every npc
+    sprite_data model;
+    double model_scaling;
+    double hurtbox_width, hurtbox_height;
+    int footprint_width, footprint_height; // size of the npcs in tiles
+    double speed;                          // pixels per ms
+    double auto_move_max_distance;         // the range at which the destination can be from the npc's position (in a square)
+    double new_position_cooldown;          // ms
+
+    // update state for the chunks
+    unsigned long long seed;                             // seed of the random streams the npcs pick destinations with
+    int update_count;
+    vector<vector<npc_path_request_data>> chunk_requests; // path requests each chunk made during the current update
+
+    int get_chunk_count() const
+    {
+        return (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    }
+
+    // pick a new destination for an npc, the path request is stored in the chunk's requests and sent after the parallel part
+    void set_new_destination(int i, const room_data &room, random_stream_data &random, coordinate min_tile, coordinate max_tile, vector<npc_path_request_data> &requests)
+    {
+        double tile_size = room.get_tile_size();
+        coordinate start_tile = {floor(position_x[i] / tile_size), floor(position_y[i] / tile_size)};
+
+        // picking from the positions the npc fits in, if there are none in range any position in the room is used
+        coordinate tile;
+        coordinate room_max = {(double)(room.get_size_x() - 1), (double)(room.get_size_y() - 1)};
+        if (!room.random_free_position(footprint_width, footprint_height, min_tile, max_tile, tile, random) &&
+            !room.random_free_position(footprint_width, footprint_height, {0, 0}, room_max, tile, random))
+        {
+            tile = start_tile; // the npc does not fit anywhere, so it stays where it is
+        }
+
+        destination_x[i] = tile.x * tile_size;
+        destination_y[i] = tile.y * tile_size;
+        time_since_new_position[i] = 0;
+
+        requests.push_back({i, path_ticket[i] == WAITING_FOR_REQUEST ? -1 : path_ticket[i], start_tile, tile});
+        path_ticket[i] = WAITING_FOR_REQUEST;
+        paths[i].clear();
+    }
+
+    // update the npcs of one chunk, only touches the chunk's npcs and requests so chunks can run on any thread
+    void update_chunk(int chunk, double delta_time, const room_data &room)
+    {
+        TRACE_ZONE("npc chunk");
+        double tile_size = room.get_tile_size();
+        int first = chunk * CHUNK_SIZE;
+        int last = std::min(count, first + CHUNK_SIZE);
+        vector<npc_path_request_data> &requests = chunk_requests[chunk];
+        requests.clear();
+
+        // each chunk has its own random stream for each update, so the destinations do not depend on which thread runs it
+        random_stream_data random(seed, ((unsigned long long)update_count << 32) | (unsigned long long)chunk);
+
+        for (int i = first; i < last; i++)
+        {
+            time_since_new_position[i] += delta_time;
+        }
+
+        // new destinations for npcs that reached theirs (within 10 pixels) or had it for too long
+        for (int i = first; i < last; i++)
+        {
+            bool at_destination = std::abs(position_x[i] - destination_x[i]) <= 10 && std::abs(position_y[i] - destination_y[i]) <= 10;
+            if (health[i] > 0 && (at_destination || time_since_new_position[i] >= new_position_cooldown))
+            {
+                coordinate min_tile = {floor((position_x[i] - auto_move_max_distance) / tile_size), floor((position_y[i] - auto_move_max_distance) / tile_size)};
+                coordinate max_tile = {floor((position_x[i] + auto_move_max_distance) / tile_size), floor((position_y[i] + auto_move_max_distance) / tile_size)};
+                set_new_destination(i, room, random, min_tile, max_tile, requests);
+            }
+        }
+
+        // movement towards the target for this update, npcs waiting for a path or dead npcs do not move
+        double step = speed * delta_time;
+        for (int i = first; i < last; i++)
+        {
+            double direction_x = target_x[i] - position_x[i];
+            double direction_y = target_y[i] - position_y[i];
+            double length = std::sqrt(direction_x * direction_x + direction_y * direction_y);
+            double scale = (length > 0 && health[i] > 0 && path_ticket[i] == -1) ? std::min(step, length) / length : 0.0;
+            velocity_x[i] = direction_x * scale;
+            velocity_y[i] = direction_y * scale;
+            facing_right[i] = direction_x > 0;
+        }
+
+        // moving through the room, stopping at walls
+        for (int i = first; i < last; i++)
+        {
+            previous_x[i] = position_x[i];
+            previous_y[i] = position_y[i];
+            if (velocity_x[i] == 0 && velocity_y[i] == 0)
+            {
+                continue;
+            }
+
+            vector_2d movement = room.sweep_box({position_x[i], position_y[i], hurtbox_width, hurtbox_height}, {velocity_x[i], velocity_y[i]});
+            position_x[i] += movement.x;
+            position_y[i] += movement.y;
+        }
+
+        // heading to the next tile of the path once the target is reached
+        for (int i = first; i < last; i++)
+        {
+            if (std::abs(target_x[i] - position_x[i]) < 0.5 && std::abs(target_y[i] - position_y[i]) < 0.5 && path_index[i] < paths[i].size())
+            {
+                path_index[i]++;
+                update_target(i, tile_size);
+            }
+        }
+    }
+
+    // run job(chunk) for every chunk, on the job system if there is one
+    void for_each_chunk(job_system_data *job_system, const std::function<void(int)> &job)
+    {
+        if (job_system)
+        {
+            job_system->parallel_for(get_chunk_count(), job);
+            return;
+        }
+        for (int chunk = 0; chunk < get_chunk_count(); chunk++)
+        {
+            job(chunk);
+        }
+    }
+
+    // set the npc's target to the tile of its path it is heading to, or to its destination at the end of the path
+    void update_target(int i, double tile_size)
+    {
+        if (path_index[i] < paths[i].size())
+        {
+            target_x[i] = paths[i][path_index[i]].x * tile_size;
+            target_y[i] = paths[i][path_index[i]].y * tile_size;
+        }
+        else
+        {
+            target_x[i] = destination_x[i];
+            target_y[i] = destination_y[i];
+        }
+    }
+
+public:
+    // Constructor, places count npcs at random positions in the room, the seed decides the destinations the npcs pick
+    npc_store_data(int count, double tile_size, double model_size, const room_data &room, const sprite_data &model, unsigned long long seed)
+    {
+        this->count = count;
+        this->seed = seed;
+        update_count = 0;
+        chunk_requests.assign(get_chunk_count(), {});
+        this->model = model;
+
+        // setting the model size, calculated by the smallest side of the model (same as character_data)
+        model_scaling = model.get_scaling(model_size);
+        hurtbox_width = model.width * model_scaling;
+        hurtbox_height = model.height * model_scaling;
+        footprint_width = (int)ceil(hurtbox_width / room.get_tile_size());
+        footprint_height = (int)ceil(hurtbox_height / room.get_tile_size());
+
+        speed = 4 * tile_size / 1000;
+        auto_move_max_distance = 10 * tile_size;
+        new_position_cooldown = 5000;
+
+        position_x.assign(count, 0);
+        position_y.assign(count, 0);
+        velocity_x.assign(count, 0);
+        velocity_y.assign(count, 0);
+        target_x.assign(count, 0);
+        target_y.assign(count, 0);
+        time_since_new_position.assign(count, 0);
+        health.assign(count, 1);
+        facing_right.assign(count, 1);
+        destination_x.assign(count, 0);
+        destination_y.assign(count, 0);
+        path_ticket.assign(count, -1);
+        path_index.assign(count, 0);
+        paths.assign(count, {});
+
+        // spawning the npcs anywhere in the room they fit, standing still until they get a destination
+        coordinate room_max = {(double)(room.get_size_x() - 1), (double)(room.get_size_y() - 1)};
+        random_stream_data random(seed);
+        for (int i = 0; i < count; i++)
+        {
+            coordinate tile = {0, 0};
+            room.random_free_position(footprint_width, footprint_height, {0, 0}, room_max, tile, random);
+            position_x[i] = destination_x[i] = target_x[i] = tile.x * room.get_tile_size();
+            position_y[i] = destination_y[i] = target_y[i] = tile.y * room.get_tile_size();
+        }
+        previous_x = position_x;
+        previous_y = position_y;
+    }
+
+    // update every npc, must be called in the game loop
+    // the npcs are updated in chunks on the job system's threads when one is given, the results are the same either way
+    // paths requested from the path finder are collected on later updates, after the path finder processes them
+    void update(double delta_time, const room_data &room, path_finder_data &path_finder, job_system_data *job_system = nullptr)
+    {
+        TRACE_ZONE("npc update");
+        double tile_size = room.get_tile_size();
+
+        // collecting finished paths, without a path the npc moves straight to its destination (the path finder is not thread safe)
+        for (int i = 0; i < count; i++)
+        {
+            bool found;
+            if (path_ticket[i] != -1 && path_finder.take_path(path_ticket[i], paths[i], found))
+            {
+                if (!found)
+                {
+                    paths[i].clear();
+                }
+                path_ticket[i] = -1;
+                path_index[i] = 0;
+                update_target(i, tile_size);
+            }
+        }
+
+        // the room builds its free space tables on the first query, so they are built here before the threads share the room
+        room.prepare_free_space(footprint_width, footprint_height);
+
+        for_each_chunk(job_system, [&](int chunk)
+                       { update_chunk(chunk, delta_time, room); });
+        update_count++;
+
+        // sending the path requests in chunk order, so the tickets are the same on any number of threads
+        for (int chunk = 0; chunk < chunk_requests.size(); chunk++)
+        {
+            for (int i = 0; i < chunk_requests[chunk].size(); i++)
+            {
+                const npc_path_request_data &request = chunk_requests[chunk][i];
+                if (request.old_ticket != -1)
+                {
+                    path_finder.cancel_path(request.old_ticket);
+                }
+                path_ticket[request.npc] = path_finder.request_path(request.start_tile, request.goal_tile, footprint_width, footprint_height);
+            }
+        }
+    }
+
+    // check the npcs' hurtboxes against a hitbox, each npc touched by the hitbox loses health (touching edges do not count)
+    // an empty hitbox (the player's when not attacking) touches nothing, the same as character_data::check_hitbox_collision
+    void check_hitbox_collision(const rectangle &hitbox, job_system_data *job_system = nullptr)
+    {
+        if (hitbox.width == 0 || hitbox.height == 0)
+        {
+            return;
+        }
+
+        for_each_chunk(job_system, [&](int chunk)
+                       {
+                           int last = std::min(count, (chunk + 1) * CHUNK_SIZE);
+                           for (int i = chunk * CHUNK_SIZE; i < last; i++)
+                           {
+                               bool hit = position_x[i] < hitbox.x + hitbox.width && hitbox.x < position_x[i] + hurtbox_width &&
+                                          position_y[i] < hitbox.y + hitbox.height && hitbox.y < position_y[i] + hurtbox_height;
+                               health[i] -= hit ? 1 : 0;
+                           } });
+    }
+
+    // add the npcs that are on the screen to the sprite batch, zoomed by the camera
+    // interpolation is how far the clock is between the last update and the next (0 to 1)
+    void draw(const camera_data &camera, sprite_batch_data &batch, double interpolation = 1) const
+    {
+        double zoomed_model_scaling = model_scaling * camera.get_zoom_level();
+
+        for (int i = 0; i < count; i++)
+        {
+            if (health[i] <= 0 || !camera.is_visible(get_hurtbox(i)))
+            {
+                continue;
+            }
+
+            coordinate drawn_position = {previous_x[i] + (position_x[i] - previous_x[i]) * interpolation, previous_y[i] + (position_y[i] - previous_y[i]) * interpolation};
+            coordinate zoomed_position = camera.get_zoomed(drawn_position);
+
+            // flip when facing opposite direction
+            batch.add(model, zoomed_position.x, zoomed_position.y, zoomed_model_scaling, !facing_right[i]);
+        }
+    }
+
+    // check if any of the npcs is dead
+    bool has_dead_npc() const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (health[i] <= 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // getters and setters
+    int get_count() const
+    {
+        return count;
+    }
+
+    int get_health(int i) const
+    {
+        return health[i];
+    }
+
+    void set_health(int i, int health)
+    {
+        this->health[i] = health;
+    }
+
+    coordinate get_position(int i) const
+    {
+        return {position_x[i], position_y[i]};
+    }
+
+    rectangle get_hurtbox(int i) const
+    {
+        return {position_x[i], position_y[i], hurtbox_width, hurtbox_height};
+    }
+};
+
+enum sword_phase
+{
+    SWORD_DRAW = 0,
+    SWORD_SWING,
+    NO_SWORD
+};
+
+// sword info stuct
+struct sword_data
+{
+    sprite_data sword_draw_model;  // sprite of the sword when the player is drawing the sword
+    sprite_data sword_swing_model; // sprite of the sword when the player is swinging the sword
+    double model_scaling;     // scaling of the sword model
+    coordinate position;      // position of the sword
+    sword_phase phase;        // the phase of the sword (drawing, swinging, or no sword) (used to determine which bitmap to draw)
+};
+
+// player info struct, players can attack
+class player_data : public character_data
+{
+private:
+    int attack_speed;        // ms
+    bool is_attacking;       // if true, the player is attacking, used to check with timing and drawing
+    bool create_hitbox;      // if true, the player's sword will have a hitbox
+    rectangle hitbox;        // the hitbox of the sword, the hitbox is active when the player is attacking
+    int hitbox_lasting_time; // ms
+    double attack_cooldown;  // ms
+    bool can_attack;         // if true, the player can attack, if false, the player is in cooldown
+
+    sword_data sword;
+
+    // main function for attacking, controls the attacking animation, and the time the hitbox is active (according to attack_speed)
+    void attacking()
+    {
+        // if the player is not attacking, the sword phase is set to no sword
+        if (!is_attacking)
+        {
+            sword.phase = NO_SWORD; // doesnt draw the sword on the screen if the phase is no sword
+            return;
+        }
+
+        // NOTE: sword animation and progress takes 2 * attack_speed
+
+        // for the start of the animaion, the player is drawing the sword for attack_speed
+        if (attack_cooldown < attack_speed)
+        {
+            sword.phase = SWORD_DRAW;
+            return;
+        }
+
+        // after attakc_speed time, the player is swinging the sword for attack_speed * 0.5
+        if (attack_cooldown < attack_speed * 1.5)
+        {
+            sword.phase = SWORD_SWING;
+
+            // create hitbox when the player is swinging the sword, only for hitbox_lasting_time
+            if (attack_cooldown < attack_speed + hitbox_lasting_time)
+                create_hitbox = true;
+            else
+                create_hitbox = false;
+
+            return;
+        }
+        sword.phase = NO_SWORD; // doesnt draw the sword on the screen if the phase is no sword
+    }
+
+    // update the attack cooldown, and the attack state
+    void update_attack_cooldown(double delta_time)
+    {
+        attack_cooldown += delta_time;
+
+        if (attack_cooldown >= attack_speed * 2)
+        {
+            can_attack = true;
+            is_attacking = false;
+            attack_cooldown = 0;
+        }
+        else
+            can_attack = false;
+    }
+
+    // update the sword's hitbox to align with the player's position
+    void update_hitbox()
+    {
+        double player_model_width = get_model().width;
+        double player_model_height = get_model().height;
+
+        double sword_model_width = sword.sword_draw_model.width;
+        double sword_model_height = sword.sword_draw_model.height;
+        double hitbox_size_x, hitbox_size_y;
+
+        // player hitbox is 0 if there isnt an attack happening (which is when create_hitbox is false)
+        if (create_hitbox)
+        {
+            hitbox_size_x = sword_model_width * sword.model_scaling;
+            hitbox_size_y = sword_model_height * sword.model_scaling * (player_model_height / player_model_width);
+            // playermodelheight / playermodelwidth because model_scaling is derived from player_model_width
+        }
+        else
+        {
+            hitbox_size_x = 0;
+            hitbox_size_y = 0;
+        }
+
+        // align the sword's hitbox with the player's direction
+        if (get_is_facing_right())
+            hitbox = {get_position().x + (player_model_width * get_model_scaling()), get_position().y, hitbox_size_x, hitbox_size_y};
+        else
+            hitbox = {get_position().x - hitbox_size_x, get_position().y, hitbox_size_x, hitbox_size_y};
+    }
+
+    // update the sword's position to align with the player's position
+    void update_sword()
+    {
+        sword.phase = NO_SWORD; // default phase is no sword
+
+        double player_model_width = get_model().width;
+        double player_model_height = get_model().height;
+
+        double sword_model_width = sword.sword_draw_model.width;
+
+        double model_scaling = get_model_scaling();
+
+        // making the sword align with the player
+        if (get_is_facing_right())
+        {
+            sword.position.x = get_position().x + (player_model_width * model_scaling);
+            sword.position.y = get_position().y + (player_model_height / (player_model_height / player_model_width) * model_scaling);
+        }
+        else
+        {
+            sword.position.x = get_position().x - (sword_model_width * sword.model_scaling);
+            sword.position.y = get_position().y + (player_model_height / (player_model_height / player_model_width) * model_scaling);
+        }
+    }
+
+    // add player's sword to the sprite batch, zoomed by the camera (moved with the player's drawn position)
+    void draw_sword(const camera_data &camera, sprite_batch_data &batch, double interpolation) const
+    {
+        double scaling = sword.model_scaling * camera.get_zoom_level();
+
+        double player_model_height = get_model().height;
+        double player_model_width = get_model().width;
+
+        coordinate drawn_position = get_drawn_position(interpolation);
+        coordinate zoomed_position = camera.get_zoomed(coordinate{sword.position.x + drawn_position.x - get_position().x, sword.position.y + drawn_position.y - get_position().y});
+
+        sword_phase model = sword.phase;
+
+        double model_scaling = get_model_scaling() * camera.get_zoom_level();
+
+        // flip when facing opposite direction
+        if (model == SWORD_DRAW)
+            batch.add(sword.sword_draw_model, zoomed_position.x, zoomed_position.y, scaling, !get_is_facing_right());
+        if (model == SWORD_SWING)
+            batch.add(sword.sword_swing_model, zoomed_position.x, zoomed_position.y - (player_model_height / (player_model_height / player_model_width) * model_scaling), scaling, !get_is_facing_right());
+    }
+
+public:
+    // Constructor
+    player_data(double tile_size, double model_size, const coordinate &spawn_coords, const sprite_data &model, const sprite_data &sword_draw_model, const sprite_data &sword_swing_model)
+        : character_data(1, 5.0 * tile_size / 1000, model, true, model_size, spawn_coords)
+    {
+        attack_speed = 1000;       // ms
+        hitbox_lasting_time = 100; // ms
+
+        can_attack = true;
+        attack_cooldown = 0;
+        is_attacking = false;
+        create_hitbox = false;
+
+        double model_width = get_model().width;
+        double model_height = get_model().height;
+
+        // setting sword struct
+        sword.sword_draw_model = sword_draw_model;
+        sword.sword_swing_model = sword_swing_model;
+
+        // both sword bitmap have the same size
+        sword.model_scaling = sword.sword_draw_model.get_scaling(model_size);
+
+        // updating hitbox, hurtbox and model scaling
+        character_data::update();
+        update_hitbox();
+        // calling update to set the sword's position
+        update_sword();
+    }
+
+    player_data(double tile_size, double model_size, const sprite_data &model, const sprite_data &sword_draw_model, const sprite_data &sword_swing_model)
+        : player_data(tile_size, model_size, {0, 0}, model, sword_draw_model, sword_swing_model) {}
+
+    // attack function to call the player to attack (only if the player can attack)
+    void attack()
+    {
+        if (can_attack)
+        {
+            is_attacking = true;
+        }
+    }
+
+    // must be ran inside game loop, and get delta_time from game_timing_data
+    void update(double delta_time)
+    {
+        // no need to update if the player is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        character_data::update();
+        update_hitbox();
+        update_sword();
+
+        if (is_attacking)
+        {
+            // if the player is attacking, update the attack cooldown and the attack state
+            update_attack_cooldown(delta_time);
+            // continue the attacking process
+            attacking();
+        }
+    }
+
+    // get the player's sword hitbox
+    const rectangle &get_hitbox() const
+    {
+        return hitbox;
+    }
+
+    void draw(const camera_data &camera, sprite_batch_data &batch, double interpolation = 1) const
+    {
+
+        // no need to draw if the player is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        character_data::draw(camera, batch, interpolation);
+        draw_sword(camera, batch, interpolation);
+    }
+};
+
+// monster class, inherits from character_data, can disguise as npc (friendship with npc_data)
+class monster_data : public character_data
+{
+private:
+    // if the monster is exposed, it will be drawn, if not, the disguise will be drawn
+    bool expose_self;
+
+    // the range at which the monster will detect the player
+    double player_detection_range;
+    bool escaped_player; // if the monster has escaped the player out of detection range, it is true, if not, it is false
+
+    npc_data *disguise; // the npc object disguise of the monster
+    rectangle hitbox;   // the hitbox of the monster, the hitbox is active when the monster is exposed
+
+    // escape the player by moving away from the player, following the flee map (for the disguise's size) away from the player when it can
+    void escape_player(const player_data &player, const room_data &room, const distance_map_data &flee_map)
+    {
+        // getting direction between the player and the monster
+        vector_2d direction = {0, 0};
+        direction.x = get_position().x - player.get_position().x;
+        direction.y = get_position().y - player.get_position().y;
+
+        // the distance between the player and the monster, if the distance is greater than the player_detection_range, the monster has escaped the player
+        double distance = vector_magnitude(direction);
+        if (distance > player_detection_range)
+        {
+            if (!escaped_player)
+            {
+                // this is to reset the disguise's position to activate the new position for npc object to automatically move to
+                // in the NPC class, if the new position is the same as the current position, the npc will get a random new position and move to it
+                disguise->set_new_position(get_position());
+            }
+
+            escaped_player = true;
+            return;
+        }
+
+        // if the monster has not escapted the player, it will move away from the player
+        escaped_player = false;
+        if (direction.x != 0 || direction.y != 0)
+        {
+            // convert to unit vector
+            direction = unit_vector(direction);
+        }
+
+        // the disguise moves to the neighbouring tile furthest from the player (going around walls)
+        // if there is none it will move away from the player at the shortest distance
+        vector_2d flee_direction = flee_map.get_direction(room, disguise->get_position(), false);
+        if (flee_direction.x != 0 || flee_direction.y != 0)
+        {
+            direction = unit_vector(flee_direction);
+        }
+
+        // the new position is a tile away, so the disguise does not count it as reached (npcs are at their destination within 10 pixels)
+        double flee_distance = room.get_tile_size();
+        disguise->set_new_position({get_position().x + direction.x * flee_distance, get_position().y + direction.y * flee_distance});
+    }
+
+    // chase the player by following the chase map (for the monster's size) to the player, used when the monster is exposed
+    // moves directly towards the player when it already covers the player's tile or the map has no path
+    void chase_player(double delta_time, const player_data &player, const room_data &room, const distance_map_data &chase_map)
+    {
+        // the monster grows out of its disguise when it is exposed, if it grew into a wall it is moved to the nearest place it fits
+        double tile_size = room.get_tile_size();
+        const rectangle &box = get_hurtbox();
+        int start_x = (int)floor(box.x / tile_size), start_y = (int)floor(box.y / tile_size);
+        int end_x = (int)ceil((box.x + box.width) / tile_size), end_y = (int)ceil((box.y + box.height) / tile_size);
+        int fit_x, fit_y;
+        if (!room.is_area_passable(start_x, start_y, end_x - start_x, end_y - start_y) && chase_map.find_nearest_position(start_x, start_y, fit_x, fit_y))
+        {
+            set_position({fit_x * tile_size, fit_y * tile_size});
+            update_hurtbox();
+        }
+
+        vector_2d direction = chase_map.get_direction(room, get_position(), true);
+        if (direction.x == 0 && direction.y == 0)
+        {
+            direction.x = player.get_center_position().x - get_center_position().x;
+            direction.y = player.get_center_position().y - get_center_position().y;
+        }
+
+        // set the direction the monster is facing, for drawing
+        if (direction.x > 0)
+        {
+            set_is_facing_right(true);
+        }
+        else
+        {
+            set_is_facing_right(false);
+        }
+
+        // the distance the monster will move according to delta_time
+        double distance = get_speed() * delta_time;
+
+        move(direction, distance, room);
+    }
+
+    // update the monster's hitbox
+    void update_hitbox()
+    {
+        // the monster's hitbox the same as its hurtbox
+        hitbox = get_hurtbox();
+
+        // if the monster is not exposed, the hitbox is 0
+        if (!expose_self)
+        {
+            hitbox.height = 0;
+            hitbox.width = 0;
+        }
+    }
+
+public:
+    // Constructor
+    monster_data(double tile_size, double model_disguise_size, double model_size, const room_data &room, const sprite_data &disguise_model, const sprite_data &model, unsigned long long seed)
+        : character_data(1, 15 * tile_size / 1000, model, true, model_size, {0, 0})
+    {
+        expose_self = false;
+
+        // creating an npc object for the monster to disguise as
+        disguise = new npc_data(tile_size, model_disguise_size, room, disguise_model, seed);
+        player_detection_range = 4 * tile_size;
+        escaped_player = true;
+        update_hitbox();
+    }
+
+    // set the footprints of the distance maps the monster follows, the chase map is for the monster and the flee map for its disguise
+    void prepare_distance_maps(const room_data &room, distance_map_data &chase_map, distance_map_data &flee_map) const
+    {
+        int width, height;
+        get_tile_footprint(room, width, height);
+        chase_map.set_footprint(width, height);
+        disguise->get_tile_footprint(room, width, height);
+        flee_map.set_footprint(width, height);
+    }
+
+    // update itself and the disguise object, must be called in the game loop
+    // the distance maps must be measured from the player and prepared by prepare_distance_maps, they are used to move around walls
+    // the path finder is used by the disguise
+    void update(double delta_time, const room_data &room, const player_data &player, const distance_map_data &chase_map, const distance_map_data &flee_map, path_finder_data &path_finder)
+    {
+
+        // no need to update if the monster is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        disguise->update(delta_time, room, path_finder);
+        character_data::update();
+        update_hitbox();
+
+        // syncronize stats of the monster and the disguise
+        if (!expose_self)
+        {
+            // if the monster is not exposed, the monster will take the disguise's position and health
+            set_position(disguise->get_position());
+            set_health(disguise->get_health());
+            escape_player(player, room, flee_map);
+        }
+        else
+        {
+            // if the monster is exposed, the disguised will take the monster's position and health
+            disguise->set_position(get_position());
+            disguise->set_health(get_health());
+            chase_player(delta_time, player, room, chase_map);
+        }
+    }
+
+    // keep the positions of the monster and its disguise before an update, must be called before each update
+    void save_previous_position()
+    {
+        character_data::save_previous_position();
+        disguise->save_previous_position();
+    }
+
+    // add the monster to the sprite batch
+    void draw(const camera_data &camera, sprite_batch_data &batch, double interpolation = 1) const
+    {
+        // no need to draw if the monster is dead
+        if (get_health() <= 0)
+        {
+            return;
+        }
+
+        if (expose_self)
+        {
+            // if the monster is exposed, the monster will be drawn
+            character_data::draw(camera, batch, interpolation);
+        }
+        else
+        {
+            // if the monster is not exposed, the disguise will be drawn
+            disguise->draw(camera, batch, interpolation);
+        }
+    }
+
+    // draw the outline of the disguise onto the screen with an alpha (drawn over the sprite batch)
+    void draw_outline(const camera_data &camera, double alpha, double interpolation = 1) const
+    {
+        if (get_health() > 0 && !expose_self && alpha > 0)
+        {
+            coordinate drawn_position = disguise->get_drawn_position(interpolation);
+            rectangle outline = {drawn_position.x, drawn_position.y, disguise->get_hurtbox().width, disguise->get_hurtbox().height};
+            fill_rectangle(rgba_color(150.0, 170.0, 200.0, alpha), camera.get_zoomed(outline));
+        }
+    }
+
+    // check if the monster's hitbox is colliding with a hitbox
+    void check_hitbox_collision(const rectangle &hitbox)
+    {
+        if (expose_self)
+        {
+            character_data::check_hitbox_collision(hitbox);
+        }
+        else
+        {
+            disguise->check_hitbox_collision(hitbox);
+        }
+    }
+
+    // getters and setters
+    void set_expose_self(bool expose_self)
+    {
+        this->expose_self = expose_self;
+    }
+
+    // the exposed monster follows the chase map, the disguised monster the flee map
+    bool is_exposed() const
+    {
+        return expose_self;
+    }
+
+    const rectangle &get_hitbox() const
+    {
+        return hitbox;
+    }
+};
+
+// the player's controls for one update, read from the keyboard and mouse, or made up when running headless
+struct input_data
+{
+    bool move_up;
+    bool move_down;
+    bool move_left;
+    bool move_right;
+    bool attack;
+    bool focus; // using the focusing ability (slowing time)
+};
+
+// read the player's controls from the keyboard and mouse
+input_data read_input()
+{
+    input_data input;
+    input.move_up = key_down(W_KEY);
+    input.move_down = key_down(S_KEY);
+    input.move_left = key_down(A_KEY);
+    input.move_right = key_down(D_KEY);
+    input.attack = key_down(SPACE_KEY) || mouse_clicked(LEFT_BUTTON);
+    input.focus = key_down(LEFT_SHIFT_KEY) || mouse_down(RIGHT_BUTTON);
+    return input;
+}
+
+// made up controls for running headless, the player walks in a random direction that changes every so often and attacks now and then
+class scripted_input_data
+{
+private:
+    random_stream_data random;
+    input_data input;
+    double time_until_change; // ms until a new direction is picked
+
+public:
+    // Constructor, the seed decides the controls
+    scripted_input_data(unsigned long long seed) : random(seed)
+    {
+        input = {false, false, false, false, false, false};
+        time_until_change = 0;
+    }
+
+    // get the controls for an update that is time_difference ms after the last one
+    const input_data &update(double time_difference)
+    {
+        time_until_change -= time_difference;
+        if (time_until_change <= 0)
+        {
+            input.move_up = random.next_int(2) == 1;
+            input.move_down = random.next_int(2) == 1;
+            input.move_left = random.next_int(2) == 1;
+            input.move_right = random.next_int(2) == 1;
+            input.focus = random.next_int(4) == 0;
+            time_until_change = random.next_int(250, 1500);
+        }
+        input.attack = random.next_int(50) == 0;
+        return input;
+    }
+};
+
+// the controls of every tick of a game and a rolling hash of the level's state after each tick, kept in a small replay file
+// the game seed and the controls are enough to play the game again, the hashes find the first tick where a replay stopped matching
+class input_recording_data
+{
+private:
+    static constexpr char REPLAY_MAGIC[8] = {'F', 'T', 'F', 'R', 'E', 'P', 'L', '1'};
+
+    unsigned long long seed;        // the game's seed, decides the rooms and the levels' seeds
+    vector<unsigned char> inputs;   // the controls of each tick, one bit for each control
+    vector<unsigned int> hashes;    // the low bits of the rolling hash after each tick
+    unsigned long long rolling_hash; // hash of every tick recorded so far
+
+    // numbers in the replay file are little endian
+    static void write_number(std::ofstream &file, unsigned int number)
+    {
+        unsigned char bytes[4] = {(unsigned char)number, (unsigned char)(number >> 8), (unsigned char)(number >> 16), (unsigned char)(number >> 24)};
+        file.write((const char *)bytes, sizeof(bytes));
+    }
+
+    static bool read_number(std::ifstream &file, unsigned int &number)
+    {
+        unsigned char bytes[4];
+        if (!file.read((char *)bytes, sizeof(bytes)))
+        {
+            return false;
+        }
+        number = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((unsigned int)bytes[3] << 24);
+        return true;
+    }
+
+    static unsigned char pack_input(const input_data &input)
+    {
+        return input.move_up | input.move_down << 1 | input.move_left << 2 | input.move_right << 3 | input.attack << 4 | input.focus << 5;
+    }
+
+    static input_data unpack_input(unsigned char bits)
+    {
+        return {(bits & 1) != 0, (bits & 2) != 0, (bits & 4) != 0, (bits & 8) != 0, (bits & 16) != 0, (bits & 32) != 0};
+    }
+
+public:
+    // Constructor, an empty recording of a game played with the seed
+    input_recording_data(unsigned long long seed = 0)
+    {
+        this->seed = seed;
+        rolling_hash = 0;
+    }
+
+    // roll the hash of a tick into the hash of the ticks before it, so a tick that differs changes every hash after it
+    static unsigned long long roll_hash(unsigned long long rolling_hash, unsigned long long state_hash)
+    {
+        return hash_state(rolling_hash, state_hash);
+    }
+
+    // add a tick that was updated with input and left the level with state_hash
+    void record_tick(const input_data &input, unsigned long long state_hash)
+    {
+        rolling_hash = roll_hash(rolling_hash, state_hash);
+        inputs.push_back(pack_input(input));
+        hashes.push_back((unsigned int)rolling_hash);
+    }
+
+    // write the recording, the controls are stored as runs since they stay the same for many ticks
+    bool write(const string &path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+        write_number(file, (unsigned int)seed);
+        write_number(file, (unsigned int)(seed >> 32));
+        write_number(file, inputs.size());
+
+        for (int i = 0; i < inputs.size();)
+        {
+            int run = 1;
+            while (i + run < inputs.size() && inputs[i + run] == inputs[i])
+            {
+                run++;
+            }
+            file.put((char)inputs[i]);
+            write_number(file, run);
+            i += run;
+        }
+        for (int i = 0; i < hashes.size(); i++)
+        {
+            write_number(file, hashes[i]);
+        }
+        return (bool)file;
+    }
+
+    // read a recording, returns false if there is no file or it is not a replay
+    bool read(const string &path)
+    {
+        const unsigned int MAX_TICKS = 1u << 28;
+
+        std::ifstream file(path, std::ios::binary);
+        char magic[sizeof(REPLAY_MAGIC)];
+        unsigned int seed_low, seed_high, tick_count;
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), REPLAY_MAGIC) ||
+            !read_number(file, seed_low) || !read_number(file, seed_high) || !read_number(file, tick_count) || tick_count > MAX_TICKS)
+        {
+            return false;
+        }
+        seed = seed_low | (unsigned long long)seed_high << 32;
+        rolling_hash = 0;
+        inputs.clear();
+        hashes.clear();
+
+        while (inputs.size() < tick_count)
+        {
+            char bits;
+            unsigned int run;
+            if (!file.get(bits) || !read_number(file, run) || run == 0 || run > tick_count - inputs.size())
+            {
+                return false;
+            }
+            inputs.insert(inputs.end(), run, (unsigned char)bits);
+        }
+        hashes.resize(tick_count);
+        for (int i = 0; i < tick_count; i++)
+        {
+            if (!read_number(file, hashes[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // check the rolling hash of a replayed tick against the recorded one
+    bool matches(int tick, unsigned long long replayed_rolling_hash) const
+    {
+        return hashes[tick] == (unsigned int)replayed_rolling_hash;
+    }
+
+    // getters
+    unsigned long long get_seed() const
+    {
+        return seed;
+    }
+
+    int get_tick_count() const
+    {
+        return inputs.size();
+    }
+
+    input_data get_input(int tick) const
+    {
+        return unpack_input(inputs[tick]);
+    }
+};
+
+// function to calculate and change position of player
+void move_player(player_data &player, const input_data &input, double delta_time, const room_data &room)
+{
+    // calculating distance using delta_time to avoid game lag issues
+    double distance = player.get_speed() * delta_time;
+
+    // setting the direction of the movement
+    vector_2d direction = {0, 0};
+
+    if (input.move_up)
+    {
+        direction.y -= 1;
+    }
+    if (input.move_down)
+    {
+        direction.y += 1;
+    }
+    if (input.move_left)
+    {
+        direction.x -= 1;
+        player.set_is_facing_right(false);
+    }
+    if (input.move_right)
+    {
+        direction.x += 1;
+        player.set_is_facing_right(true);
+    }
+
+    // call move function in chacter_data to move along the direction and distance
+    player.move(direction, distance, room);
+}
+
+// controls the player's attack, calls the player to attack if button is pressed
+void player_attack(player_data &player, const input_data &input)
+{
+    if (input.attack)
+    {
+        player.attack();
+    }
+}
+
+// function to draw the vignette on the screen, nothing is drawn until its bitmap is loaded
+void draw_vignette(const sprite_data &vignette, double scale = 1)
+{
+    if (vignette.model == nullptr)
+    {
+        return;
+    }
+
+    // camera position
+    point_2d camera_pos = camera_position();
+
+    // lengths and widths
+    double vignette_width = vignette.width;
+    double vignette_height = vignette.height;
+    double screen_x = screen_width();
+    double screen_y = screen_height();
+
+    // scaling the vignette to fit the screen and custom scaling
+    double scale_x = (screen_x / vignette_width) * scale;
+    double scale_y = (screen_y / vignette_height) * scale;
+
+    // getting the camera's cetner
+    double camera_center_x = camera_pos.x + (screen_x / 2);
+    double camera_center_y = camera_pos.y + (screen_y / 2);
+
+    // getting the distance of the center of the vignette
+    double vignette_center_x = (vignette_width * scale_x) / 2;
+    double vignette_center_y = (vignette_height * scale_y) / 2;
+
+    // getting the x and y position to draw the vignette (with aligning error fix from bitmap scaling)
+    double x = (camera_center_x - vignette_center_x) + vignette.pivot_x * (scale_x - 1);
+    double y = (camera_center_y - vignette_center_y) + vignette.pivot_y * (scale_y - 1);
+
+    draw_bitmap(vignette.model, x, y, (option_scale_bmp(scale_x, scale_y)));
+}
+
+// control to slow time, used for the focusing ability
+// starts easing the time rate, zoom level, desaturating filter and monster outline towards their focusing or normal values
+void control_ability(const input_data &input, tween_scheduler_data &tweens, tween_handle time_rate, tween_handle zoom_level, tween_handle filter, tween_handle outline)
+{
+    TRACE_ZONE("control ability");
+
+    if (input.focus)
+    {
+        // slowing time and zooming in with easing
+        tweens.ease_to(time_rate, 0.35);
+        tweens.ease_to(zoom_level, 2.5);
+
+        // desaturating the screen and outlining the monster
+        tweens.ease_to(filter, 0.5);
+        tweens.ease_to(outline, 0.5);
+        return;
+    }
+
+    // returning time and zoom to normal with easing
+    tweens.ease_to(time_rate, 1);
+    tweens.ease_to(zoom_level, 1);
+
+    // removing destauration on screen and the monster's outline
+    tweens.ease_to(filter, 0);
+    tweens.ease_to(outline, 0);
+}
+
+// draw the focusing ability's effects on the screen
+void draw_ability(const sprite_data &vignette, bool focusing, double filter_alpha)
+{
+    point_2d camera_pos = camera_position();
+
+    // vignetted screen
+    if (focusing)
+    {
+        draw_vignette(vignette);
+    }
+    // color to desaturate the screen
+    fill_rectangle(rgba_color(150.0, 170.0, 200.0, filter_alpha), camera_pos.x, camera_pos.y, screen_width(), screen_height());
+}
+
+// function to control character, must be called in the game loop
+void control_player(player_data &player, const input_data &input, game_timing_data &game_timing, const room_data &room)
+{
+    move_player(player, input, game_timing.get_delta_time(), room);
+    player_attack(player, input);
+}
+
+// function to contol counter for the game, minimum is 0, level_time is the time since the level started (ms)
+double timer_countdown(int time_limit, bool timer_over, double level_time)
+{
+    if (timer_over)
+    {
+        return 0;
+    }
+
+    double timer = (double)time_limit - level_time;
+    if (timer <= 0)
+    {
+        timer = 0;
+    }
+    return timer;
+}
+
+// get the color part way (0 to 1) from one color to another
+color lerp_color(const color &from, const color &to, double part)
+{
+    return rgb_color(from.r + (to.r - from.r) * part, from.g + (to.g - from.g) * part, from.b + (to.b - from.b) * part);
+}
+
+// change color of the room as timer goes down, change from initial color to new color array
+void change_color(double time_left, int time_start_warning, room_data &room, color initial_color_array[3], color new_color_array[3])
+{
+    double part = 1 - (time_left / time_start_warning);
+
+    // setting the new color of the floors and walls as timer goes down
+    room.set_color_pattern(lerp_color(initial_color_array[0], new_color_array[0], part),
+                           lerp_color(initial_color_array[1], new_color_array[1], part),
+                           lerp_color(initial_color_array[2], new_color_array[2], part));
+}
+
+// visual warnings as timer goes down, change color from the initial colors to the warning colors
+void count_down_warning(double time_left, int time_start_warning, room_data &room, color initial_color_array[3], color warning_color_array[3])
+{
+    if (time_left < time_start_warning)
+    {
+        change_color(time_left, time_start_warning, room, initial_color_array, warning_color_array);
+    }
+}
+
+// draw the vignette zooming in as timer goes down, and the warning color over the screen once the time is out
+void draw_count_down_warning(const sprite_data &vignette, double time_left, int time_start_warning, const color &warning_color, double warning_alpha)
+{
+    if (time_left < time_start_warning)
+    {
+        // vignette zooming in as timer goes down, from initial scale to final scale
+        double initial_vignette_scale = 5;
+        double final_vignette_scale = 1.5;
+        double scale = initial_vignette_scale - ((initial_vignette_scale - final_vignette_scale) * (1 - (time_left / time_start_warning)));
+        draw_vignette(vignette, scale);
+        if (time_left <= 0)
+        {
+            point_2d camera_pos = camera_position();
+            fill_rectangle(rgba_color(warning_color.r, warning_color.g, warning_color.b, warning_alpha), camera_pos.x, camera_pos.y, screen_width(), screen_height());
+        }
+    }
+}
+
+// handle of a piece of text in the hud text cache
+typedef int hud_text_handle;
+
+// a piece of text rendered into a bitmap (or a part of one)
+struct hud_text_data
+{
+    bitmap image;
+    rectangle part; // where the text is in the bitmap
+};
+
+// hud text rendered into bitmaps once and drawn from them, so drawing the hud does not measure or build any text
+// static text is rendered whole, numbers are put together from a strip of rendered digits for each font size
+// nothing is rendered until it is first added or drawn, so a level that is never drawn (headless) makes no bitmaps
+class hud_text_cache_data
+{
+private:
+    // the digits and the decimal point rendered side by side into one bitmap, for one font size
+    struct digit_strip_data
+    {
+        int font_size;
+        bitmap image;
+        rectangle glyphs[11]; // "0123456789" then "."
+    };
+
+    vector<hud_text_data> texts;                         // indexed by handle
+    std::unordered_map<string, hud_text_handle> handles; // text and font size, only used when adding text
+    vector<digit_strip_data> digit_strips;
+
+    // render text in white into a new bitmap its size
+    static bitmap render(const string &name, const string &text, int font_size)
+    {
+        bitmap image = create_bitmap(name, text_width(text, get_system_font(), font_size), text_height(text, get_system_font(), font_size));
+        clear_bitmap(image, color_transparent());
+        draw_text_on_bitmap(image, text, color_white(), get_system_font(), font_size, 0, 0);
+        return image;
+    }
+
+    // get the digit strip for a font size, rendering it the first time the size is used
+    const digit_strip_data &get_digit_strip(int font_size)
+    {
+        const string GLYPHS = "0123456789.";
+
+        for (int i = 0; i < digit_strips.size(); i++)
+        {
+            if (digit_strips[i].font_size == font_size)
+            {
+                return digit_strips[i];
+            }
+        }
+
+        // every glyph gets a slot as wide as the widest glyph
+        digit_strip_data strip;
+        strip.font_size = font_size;
+        double slot_width = 0, height = 0;
+        for (int i = 0; i < GLYPHS.size(); i++)
+        {
+            string glyph = GLYPHS.substr(i, 1);
+            strip.glyphs[i] = {0, 0, (double)text_width(glyph, get_system_font(), font_size), (double)text_height(glyph, get_system_font(), font_size)};
+            slot_width = std::max(slot_width, strip.glyphs[i].width);
+            height = std::max(height, strip.glyphs[i].height);
+        }
+
+        strip.image = create_bitmap("hud_digits_" + std::to_string(font_size), slot_width * GLYPHS.size(), height);
+        clear_bitmap(strip.image, color_transparent());
+        for (int i = 0; i < GLYPHS.size(); i++)
+        {
+            strip.glyphs[i].x = i * slot_width;
+            draw_text_on_bitmap(strip.image, GLYPHS.substr(i, 1), color_white(), get_system_font(), font_size, strip.glyphs[i].x, 0);
+        }
+
+        digit_strips.push_back(strip);
+        return digit_strips.back();
+    }
+
+public:
+    hud_text_cache_data() {}
+
+    // the bitmaps are owned by the cache, so caches cannot be copied
+    hud_text_cache_data(const hud_text_cache_data &) = delete;
+    hud_text_cache_data &operator=(const hud_text_cache_data &) = delete;
+
+    // Destructor
+    ~hud_text_cache_data()
+    {
+        for (int i = 0; i < texts.size(); i++)
+        {
+            free_bitmap(texts[i].image);
+        }
+        for (int i = 0; i < digit_strips.size(); i++)
+        {
+            free_bitmap(digit_strips[i].image);
+        }
+    }
+
+    // add text at a font size, rendering it if it has not been added before, returns its handle (add text once, not every frame)
+    hud_text_handle add(const string &text, int font_size)
+    {
+        string key = std::to_string(font_size) + ":" + text;
+        auto it = handles.find(key);
+        if (it != handles.end())
+        {
+            return it->second;
+        }
+
+        bitmap image = render("hud_text_" + std::to_string(texts.size()), text, font_size);
+        texts.push_back({image, {0, 0, (double)bitmap_width(image), (double)bitmap_height(image)}});
+        handles[key] = texts.size() - 1;
+        return texts.size() - 1;
+    }
+
+    // draw added text centered on a point
+    void draw(hud_text_handle handle, double center_x, double center_y) const
+    {
+        const hud_text_data &text = texts[handle];
+        draw_bitmap(text.image, center_x - text.part.width / 2, center_y - text.part.height / 2);
+    }
+
+    // draw a number (0 or more) centered on a point, cut (not rounded) to a number of decimals
+    void draw_number(double number, int decimals, int font_size, double center_x, double center_y)
+    {
+        const int MAX_DIGITS = 32;
+        const int DECIMAL_POINT = 10; // glyph of the decimal point in the strip
+
+        const digit_strip_data &strip = get_digit_strip(font_size);
+
+        // writing the glyphs from the last decimal to the first digit
+        int glyphs[MAX_DIGITS];
+        int glyph_count = 0;
+        decimals = std::max(0, std::min(decimals, 9));
+        long long scale = 1;
+        for (int i = 0; i < decimals; i++)
+        {
+            scale *= 10;
+        }
+        long long value = (long long)(std::max(0.0, number) * scale);
+        for (int i = 0; i < decimals; i++)
+        {
+            glyphs[glyph_count++] = value % 10;
+            value /= 10;
+        }
+        if (decimals > 0)
+        {
+            glyphs[glyph_count++] = DECIMAL_POINT;
+        }
+        do
+        {
+            glyphs[glyph_count++] = value % 10;
+            value /= 10;
+        } while (value > 0 && glyph_count < MAX_DIGITS);
+
+        double width = 0, height = 0;
+        for (int i = 0; i < glyph_count; i++)
+        {
+            width += strip.glyphs[glyphs[i]].width;
+            height = std::max(height, strip.glyphs[glyphs[i]].height);
+        }
+
+        double x = center_x - width / 2;
+        double y = center_y - height / 2;
+        for (int i = glyph_count - 1; i >= 0; i--)
+        {
+            const rectangle &glyph = strip.glyphs[glyphs[i]];
+            draw_bitmap(strip.image, x, y, option_part_bmp(glyph));
+            x += glyph.width;
+        }
+    }
+};
+
+// function to draw the timer on the screen
+void draw_timer(hud_text_cache_data &hud_text, double time_left, double window_width, double window_height)
+{
+    // drawing the time left on the screen (timer countdown), to 3 decimal places
+    double font_size = window_height * 0.05;
+
+    double text_pos_x = camera_position().x + ((double)window_width / 2.0);
+    double text_pos_y = camera_position().y + ((double)font_size);
+
+    hud_text.draw_number(time_left, 3, font_size, text_pos_x, text_pos_y);
+}
+
+// function to handle game when the timer is out
+void timer_out(npc_store_data &npcs, monster_data &monster)
+{
+    // if the timer is out, the monster will be exposed
+    monster.set_expose_self(true);
+
+    // if the timer is out, the npcs will be exposed
+    for (int i = 0; i < npcs.get_count(); i++)
+    {
+        npcs.set_health(i, 0);
+    }
+}
+
+// add the level text to the hud text cache
+hud_text_handle add_level_text(hud_text_cache_data &hud_text, int game_level, double window_height)
+{
+    double font_size = window_height * 0.025;
+    return hud_text.add("Level " + std::to_string(game_level), font_size);
+}
+
+// function to draw the level text onto the screen
+void draw_level_text(const hud_text_cache_data &hud_text, hud_text_handle level_text, double window_width, double window_height)
+{
+    // drawing the level text on the screen
+    double text_pos_x = camera_position().x + ((double)window_width / 2.0);
+    double text_pos_y = camera_position().y + ((double)window_height * 0.1);
+
+    hud_text.draw(level_text, text_pos_x, text_pos_y);
+}
+
+// add the game's control info to the hud text cache
+hud_text_handle add_control_text(hud_text_cache_data &hud_text, double window_height)
+{
+    double font_size = window_height * 0.015;
+    return hud_text.add("WASD to move | Space/Left Click to attack | Shift/Right Click to focus", font_size);
+}
+
+// function to draw the game's control info on the screen
+void draw_control_text(const hud_text_cache_data &hud_text, hud_text_handle control_text, double window_width, double window_height)
+{
+    // drawing the control text on the screen
+    double text_pos_x = camera_position().x + ((double)window_width * 0.5);
+    double text_pos_y = camera_position().y + ((double)window_height * 0.95);
+
+    hud_text.draw(control_text, text_pos_x, text_pos_y);
+}
+
+// draw the end screen, either game won or game lost
+void draw_end_screen(string text, string sub_text, const color &bg_color, double window_width, double window_height)
+{
+    // setting font sizes
+    double font_size = window_height * 0.15;
+    double font_size_small = font_size * 0.2;
+
+    // setting the position of the text according to the camera
+    double pos_x = camera_position().x + ((double)window_width / 2.0);
+    double pos_y = camera_position().y + ((double)window_height / 3.0);
+
+    // pos_y2 is for the subtext
+    double pos_y2 = camera_position().y + (((double)window_height / 3.0) * 2);
+    // text and subtext will have the same x position
+
+    double text_h = text_height(text, get_system_font(), font_size);
+    double text_w = text_width(text, get_system_font(), font_size);
+
+    double text_center_x = pos_x - (text_w / 2);
+    double text_center_y = pos_y - (text_h / 2);
+
+    double sub_text_h = text_height(sub_text, get_system_font(), font_size_small);
+    double sub_text_w = text_width(sub_text, get_system_font(), font_size_small);
+
+    double sub_text_center_x = pos_x - (sub_text_w / 2);
+    double sub_text_center_y = pos_y2 - (sub_text_h / 2);
+
+    fill_rectangle(bg_color, camera_position().x, camera_position().y, window_width, window_height);
+    draw_text(text, color_white(), get_system_font(), font_size, text_center_x, text_center_y);
+    draw_text(sub_text, color_white(), get_system_font(), font_size_small, sub_text_center_x, sub_text_center_y);
+}
+
+// what happened while generating the walls of a room
+struct wall_generation_report_data
+{
+    int placed;           // walls set in the room
+    int rejected;         // walls that were too close to another wall or the spawn
+    int removed;          // walls taken out again to keep the open tiles connected (stays 0 while walls are kept apart)
+    double coverage;      // part of the room's tiles covered by walls (0 to 1)
+    bool reached_density; // false if the coverage is below the density asked for, because too many walls in a row did not fit
+    double time;          // ms
+};
+
+// a wall being placed, in tiles, it covers x to x + width and y to y + height (both ends included, the same as room_data::set_wall)
+struct wall_placement_data
+{
+    int x, y, width, height;
+};
+
+// check if the open tiles of the room are all connected to the spawn tile, blocked has a 1 for every wall tile
+bool is_room_connected(const vector<unsigned char> &blocked, int size_x, int size_y, int spawn_x, int spawn_y)
+{
+    int open_count = 0;
+    for (int i = 0; i < blocked.size(); i++)
+    {
+        open_count += blocked[i] == 0 ? 1 : 0;
+    }
+
+    // flood filling from the spawn tile a row at a time, each run of open tiles is filled and the rows above and below are searched for runs to fill next
+    vector<unsigned char> reached(blocked.size(), 0);
+    vector<int> stack = {spawn_y * size_x + spawn_x};
+    int reached_count = 0;
+    while (!stack.empty())
+    {
+        int tile = stack.back();
+        stack.pop_back();
+        if (blocked[tile] != 0 || reached[tile] != 0)
+        {
+            continue;
+        }
+
+        int y = tile / size_x;
+        int row = y * size_x;
+        int left = tile - row, right = tile - row;
+        while (left > 0 && blocked[row + left - 1] == 0 && reached[row + left - 1] == 0)
+        {
+            left--;
+        }
+        while (right < size_x - 1 && blocked[row + right + 1] == 0 && reached[row + right + 1] == 0)
+        {
+            right++;
+        }
+        std::fill(reached.begin() + row + left, reached.begin() + row + right + 1, 1);
+        reached_count += right - left + 1;
+
+        for (int next_y = y - 1; next_y <= y + 1; next_y += 2)
+        {
+            if (next_y < 0 || next_y >= size_y)
+            {
+                continue;
+            }
+
+            // adding the first tile of every run above or below the filled run
+            int next_row = next_y * size_x;
+            bool in_run = false;
+            for (int x = left; x <= right; x++)
+            {
+                bool open = blocked[next_row + x] == 0 && reached[next_row + x] == 0;
+                if (open && !in_run)
+                {
+                    stack.push_back(next_row + x);
+                }
+                in_run = open;
+            }
+        }
+    }
+    return reached_count == open_count;
+}
+
+// generate random walls in the room until density (0 to 1) of its tiles are walls, or too many walls in a row do not fit (the report says which)
+// walls are kept at least 2 tiles apart and away from the spawn, so they can never close off part of the room (walls are rectangles no longer than a third of the room)
+// the open tiles are still checked with a flood fill, and walls are taken out from the last one placed if they are not all connected to the spawn
+// placed walls are kept in a grid of cells at least as big as a wall, so each new wall is only checked against the walls in the cells it touches
+wall_generation_report_data generate_random_walls(room_data &room, double density, random_stream_data &random)
+{
+    // NOTE: all coordinates used in here are tile coorindates, not pixel coordinates
+    const int MAX_REJECTED_IN_A_ROW = 32;
+    const int GAP = 1;          // walls are grown by this on each side when checking, touching counts, so walls end up 2 tiles apart
+    const int SPAWN_RADIUS = 3; // the tiles around the spawn that are kept free
+
+    auto start = std::chrono::steady_clock::now();
+    wall_generation_report_data report = {0, 0, 0, 0, false, 0};
+
+    int size_x = room.get_size_x();
+    int size_y = room.get_size_y();
+    int min_width = size_x / 12, max_width = size_x / 3;
+    int min_height = size_y / 12, max_height = size_y / 3;
+    coordinate spawn_tile = room.get_spawn_coords().pixel_to_tile(room.get_tile_size());
+    int spawn_x = std::max(0, std::min(size_x - 1, (int)spawn_tile.x));
+    int spawn_y = std::max(0, std::min(size_y - 1, (int)spawn_tile.y));
+
+    // the grid of placed walls, a grown wall touches at most 2 x 2 cells
+    int cell_size = std::max(max_width, max_height) + 2 * GAP + 1;
+    int cells_x = size_x / cell_size + 1;
+    int cells_y = size_y / cell_size + 1;
+    vector<vector<int>> cells(cells_x * cells_y);
+
+    vector<wall_placement_data> walls;
+    long long wall_tiles = 0;
+    long long target_tiles = (long long)(density * size_x * size_y);
+    int rejected_in_a_row = 0;
+    while (wall_tiles < target_tiles && rejected_in_a_row < MAX_REJECTED_IN_A_ROW && max_width > 0 && max_height > 0)
+    {
+        wall_placement_data wall;
+        wall.width = random.next_int(min_width, max_width);
+        wall.height = random.next_int(min_height, max_height);
+        wall.x = random.next_int(0, size_x - wall.width);
+        wall.y = random.next_int(0, size_y - wall.height);
+
+        // the wall grown by the gap, from the first tile to the last tile
+        int left = wall.x - GAP, right = wall.x + wall.width + GAP;
+        int top = wall.y - GAP, bottom = wall.y + wall.height + GAP;
+
+        bool fits = left > spawn_x + SPAWN_RADIUS || right < spawn_x - SPAWN_RADIUS || top > spawn_y + SPAWN_RADIUS || bottom < spawn_y - SPAWN_RADIUS;
+        int first_cell_x = std::max(0, left / cell_size), last_cell_x = std::min(cells_x - 1, right / cell_size);
+        int first_cell_y = std::max(0, top / cell_size), last_cell_y = std::min(cells_y - 1, bottom / cell_size);
+        for (int cell_y = first_cell_y; cell_y <= last_cell_y && fits; cell_y++)
+        {
+            for (int cell_x = first_cell_x; cell_x <= last_cell_x && fits; cell_x++)
+            {
+                for (int index : cells[cell_y * cells_x + cell_x])
+                {
+                    const wall_placement_data &other = walls[index];
+                    if (left <= other.x + other.width + GAP && other.x - GAP <= right && top <= other.y + other.height + GAP && other.y - GAP <= bottom)
+                    {
+                        fits = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (!fits)
         {
-            // convert to unit vector
-            direction = unit_vector(direction);
+            report.rejected++;
+            rejected_in_a_row++;
+            continue;
         }
 
-        // monster's disguise will move away from the player at the shortest distance
-        disguise->set_new_position({get_position().x + direction.x, get_position().y + direction.y});
+        for (int cell_y = first_cell_y; cell_y <= last_cell_y; cell_y++)
+        {
+            for (int cell_x = first_cell_x; cell_x <= last_cell_x; cell_x++)
+            {
+                cells[cell_y * cells_x + cell_x].push_back(walls.size());
+            }
+        }
+        walls.push_back(wall);
+        wall_tiles += (long long)(wall.width + 1) * (wall.height + 1);
+        rejected_in_a_row = 0;
     }
 
-    // chase the player by moving directly towards the player, used when the monster is exposed
-    void chase_player(double delta_time, const player_data &player, const room_data &room)
+    // checking the open tiles are connected, taking out the last walls until they are
+    vector<unsigned char> blocked(size_x * size_y, 0);
+    for (const wall_placement_data &wall : walls)
     {
-        vector_2d direction = {0, 0};
-        direction.x = player.get_center_position().x - get_center_position().x;
-        direction.y = player.get_center_position().y - get_center_position().y;
-
-        // set the direction the monster is facing, for drawing
-        if (direction.x > 0)
+        for (int y = wall.y; y <= std::min(size_y - 1, wall.y + wall.height); y++)
         {
-            set_is_facing_right(true);
+            std::fill(blocked.begin() + y * size_x + wall.x, blocked.begin() + y * size_x + std::min(size_x - 1, wall.x + wall.width) + 1, 1);
         }
-        else
+    }
+    while (!walls.empty() && !is_room_connected(blocked, size_x, size_y, spawn_x, spawn_y))
+    {
+        const wall_placement_data &wall = walls.back();
+        for (int y = wall.y; y <= std::min(size_y - 1, wall.y + wall.height); y++)
         {
-            set_is_facing_right(false);
+            std::fill(blocked.begin() + y * size_x + wall.x, blocked.begin() + y * size_x + std::min(size_x - 1, wall.x + wall.width) + 1, 0);
         }
+        walls.pop_back();
+        report.removed++;
+    }
 
-        // the distance the monster will move according to delta_time
-        double distance = get_speed() * delta_time;
-
-        move(direction, distance, room);
+    // setting the walls in the room
+    for (const wall_placement_data &wall : walls)
+    {
+        room.set_wall({(double)wall.x, (double)wall.y}, {(double)(wall.x + wall.width), (double)(wall.y + wall.height)});
     }
+    room.trim_tiles(); // the chunks the walls were written into are encoded if there are too many
 
-    // update the monster's hitbox
-    void update_hitbox()
+    int covered = 0;
+    for (int i = 0; i < blocked.size(); i++)
     {
-        // the monster's hitbox the same as its hurtbox
-        hitbox = get_hurtbox();
+        covered += blocked[i];
+    }
+    report.placed = walls.size();
+    report.coverage = (double)covered / (size_x * size_y);
+    report.reached_density = report.coverage >= density;
+    report.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
 
-        // if the monster is not exposed, the hitbox is 0
-        if (!expose_self)
-        {
-            hitbox.height = 0;
-            hitbox.width = 0;
-        }
+// one level of the game, updating it only runs the simulation (no window is needed) and drawing it is separate
+class level_data
+{
+private:
+    int game_level;
+    int time_limit;    // ms
+    bool timer_over;   // when timer_over is true, timer runs down to 0 instantly
+    bool game_won;
+    bool game_lost;
+    double level_time; // ms since the level started, not slowed by the time rate (real time)
+    double time_left;  // ms left on the timer
+
+    // creating game objects
+    game_size_data game_size;
+    game_timing_data game_timing;
+    room_data room;
+    // the npcs' paths are found by the path finder, with a time budget each frame
+    path_finder_data path_finder;
+    player_data player;
+    npc_store_data npcs; // keeping all the npcs in the room in one store
+    monster_data monster;
+    distance_map_data chase_map; // distances to the player for the exposed monster's footprint
+    distance_map_data flee_map;  // distances to the player for the disguise's footprint
+
+    // the camera applies the zoom level when drawing, everything else works in world coordinates
+    camera_data camera;
+    const sprite_data *vignette; // kept in the sprite registry, its bitmap is loaded after the first frame
+    sprite_batch_data sprite_batch; // the characters drawn each frame
+    hud_text_cache_data hud_text;
+    hud_text_handle level_text;   // -1 until the hud is first drawn
+    hud_text_handle control_text; // -1 until the hud is first drawn
+
+    // the eased effects of the level, all updated together by the tween scheduler
+    tween_scheduler_data tweens;
+    tween_handle time_rate_tween;
+    tween_handle zoom_level_tween;
+    tween_handle filter_tween;  // alpha of the desaturating filter while focusing
+    tween_handle outline_tween; // alpha of the monster's outline while focusing
+    tween_handle warning_tween; // alpha of the warning color once the time is out
+
+    // effects worked out by the update, for drawing
+    bool focusing;
+
+    // initial, unupdated color of room, and the color it changes to, used to show timer countdown warnings
+    color initial_color_array[3];
+    color warning_color_array[3];
+
+    // path finder work for the level
+    double path_finder_budget; // ms each update
+    int path_query_count;
+    double path_query_time;
+    int frame_count;
+
+    // streams of the level seed, one for the walls and one for each entity
+    static const int WALL_STREAM = 0;
+    static const int NPC_STREAM = 1;
+    static const int MONSTER_STREAM = 2;
+
+    // generate the room's walls before the rest of the level is made (used while initializing the members)
+    static const room_data &with_random_walls(room_data &room, double wall_density, unsigned long long level_seed)
+    {
+        random_stream_data random(level_seed, WALL_STREAM);
+        generate_random_walls(room, wall_density, random);
+        return room;
     }
 
 public:
-    // Constructor
-    monster_data(double tile_size, double model_disguise_size, double model_size, const room_data &room, string bitmap_disguise_name, string bitmap_name)
-        : character_data(1, 15 * tile_size / 1000, bitmap_named(bitmap_name), true, model_size, {0, 0})
+    // Constructor, makes a level with a room_width x room_height tile room, the level seed decides the walls and where everything starts
+    // the path finder stops after path_finder_budget ms each update, without a budget (HUGE_VAL) every request is found on the update it is made
+    level_data(int game_level, int screen_width, int screen_height, int room_width, int room_height, int tick_rate, double path_finder_budget, const sprite_registry_data &sprites, unsigned long long level_seed)
+        : game_size(screen_width, screen_height, room_width, room_height),
+          game_timing(tick_rate),
+          room(game_size.get_room_width(), game_size.get_room_height(), game_size.get_screen_width(), game_size.get_screen_height()),
+          path_finder(with_random_walls(room, 0.2, level_seed)), // a fifth of the room is walls
+          player(room.get_tile_size(), room.get_tile_size(), room.get_spawn_coords(), sprites.get(sprites.find("player_idle")), sprites.get(sprites.find("sword_1")), sprites.get(sprites.find("sword_2"))),
+          npcs(game_level + 1, room.get_tile_size(), room.get_tile_size(), room, sprites.get(sprites.find("npc_idle")), random_stream_data(level_seed, NPC_STREAM).next()), // number of npcs increases by 1 each level
+          monster(room.get_tile_size(), room.get_tile_size(), room.get_tile_size() * 2.4, room, sprites.get(sprites.find("npc_idle")), sprites.get(sprites.find("monster")), random_stream_data(level_seed, MONSTER_STREAM).next())
     {
-        show_outline = false;
-        expose_self = false;
+        vignette = &sprites.get(sprites.find("vignette"));
+        level_text = -1;
+        control_text = -1;
+        this->game_level = game_level;
+        time_limit = 60000;
+        timer_over = false;
+        game_won = false;
+        game_lost = false;
+        level_time = 0;
+        time_left = time_limit;
+
+        monster.prepare_distance_maps(room, chase_map, flee_map);
+        flee_map.update(room, player.get_center_position());
+        monster.update(0, room, player, chase_map, flee_map, path_finder);
+
+        time_rate_tween = tweens.add(1);
+        zoom_level_tween = tweens.add(1);
+        filter_tween = tweens.add(0);
+        outline_tween = tweens.add(0, 10000);
+        warning_tween = tweens.add(0.7, 800, 1000);
+
+        focusing = false;
 
-        // creating an npc object for the monster to disguise as
-        disguise = new npc_data(tile_size, model_disguise_size, room, bitmap_disguise_name);
-        player_detection_range = 4 * tile_size;
-        escaped_player = true;
-        update_hitbox();
+        const color *color_array = room.get_color_pattern();
+        for (int i = 0; i < 3; i++)
+        {
+            initial_color_array[i] = color_array[i];
+        }
+        warning_color_array[0] = rgb_color(0, 0, 0);
+        warning_color_array[1] = rgb_color(68, 68, 68);
+        warning_color_array[2] = rgb_color(139, 0, 0);
+
+        this->path_finder_budget = path_finder_budget;
+        path_query_count = 0;
+        path_query_time = 0;
+        frame_count = 0;
     }
 
-    // set zoom level for itself and the disguise object
-    void set_zoom_level(double zoom_level)
+    // move the level's clock to time (ms since the level started), the time passed is simulated by the following updates
+    void advance_clock(double time)
     {
-        character_data::set_zoom_level(zoom_level);
-        disguise->set_zoom_level(zoom_level);
+        game_timing.advance(time);
     }
 
-    // update itself and the disguise object, must be called in the game loop
-    void update(double delta_time, const room_data &room, const player_data &player)
+    // move the level's clock to time (ms since the level started) without simulating the time passed, so a pause is not lost game time
+    void resync_clock(double time)
     {
+        game_timing.resync(time);
+    }
 
-        // no need to update if the monster is dead
-        if (get_health() <= 0)
+    // run the next update if a tick of game time is waiting since the clock was advanced, returns false if there is none
+    bool update(const input_data &input, job_system_data *job_system)
+    {
+        if (!game_timing.take_tick())
         {
-            return;
+            return false;
         }
+        update_tick(input, job_system);
+        return true;
+    }
 
-        disguise->update(delta_time, room);
-        character_data::update();
-        update_hitbox();
+    // run one update (a tick of game time) with the player's controls, without looking at the clock
+    void update_tick(const input_data &input, job_system_data *job_system)
+    {
+        TRACE_ZONE("update");
+        level_time += game_timing.get_time_difference();
+        player.save_previous_position();
+        monster.save_previous_position();
 
-        // syncronize stats of the monster and the disguise
-        if (!expose_self)
+        // updating player, npcs, and monster by calling their update functions, and checking for hitbox collision
+        if (npcs.has_dead_npc())
         {
-            // if the monster is not exposed, the monster will take the disguise's position and health
-            set_position(disguise->get_position());
-            set_health(disguise->get_health());
-            escape_player(player);
+            timer_over = true;
         }
         else
         {
-            // if the monster is exposed, the disguised will take the monster's position and health
-            disguise->set_position(get_position());
-            disguise->set_health(get_health());
-            chase_player(delta_time, player, room);
+            npcs.update(game_timing.get_delta_time(), room, path_finder, job_system);
+            npcs.check_hitbox_collision(player.get_hitbox(), job_system);
         }
-    }
 
-    // draw the monster onto the screen, with easing for the outline
-    void draw(ease_data &ease, double delta_time)
-    {
-        // no need to draw if the monster is dead
-        if (get_health() <= 0)
         {
-            return;
+            TRACE_ZONE("player and monster update");
+            player.update(game_timing.get_delta_time());
+            player.check_hitbox_collision(monster.get_hitbox());
+
+            // only the map the monster follows is kept up to date, it is recalculated when the player moves to another tile
+            distance_map_data &followed_map = monster.is_exposed() ? chase_map : flee_map;
+            followed_map.update(room, player.get_center_position());
+            monster.update(game_timing.get_delta_time(), room, player, chase_map, flee_map, path_finder);
+            monster.check_hitbox_collision(player.get_hitbox());
         }
 
-        if (expose_self)
+        // finding the paths requested this frame (collected by the npcs on the next frame)
+        path_finder.process_requests(path_finder_budget);
+        path_query_count += path_finder.get_frame_query_count();
+        path_query_time += path_finder.get_frame_query_time();
+        frame_count++;
+
+        // control functions for player and ability (focusing)
+        control_player(player, input, game_timing, room);
+        focusing = input.focus;
+        control_ability(input, tweens, time_rate_tween, zoom_level_tween, filter_tween, outline_tween);
+
+        // creating visual warnings as timer goes down
+        time_left = timer_countdown(time_limit, timer_over, level_time);
+        count_down_warning(time_left, 30000, room, initial_color_array, warning_color_array);
+        if (time_left <= 0)
         {
-            // if the monster is exposed, the monster will be drawn
-            character_data::draw();
+            tweens.ease_to(warning_tween, 0.1);
         }
-        else
+
+        // easing the effects, in real time so slowing time does not slow them
+        tweens.update(game_timing.get_time_difference());
+        game_timing.set_time_rate(tweens.get_value(time_rate_tween));
+        game_size.set_zoom_level(tweens.get_value(zoom_level_tween));
+
+        // if one of the npcs is dead, the timer will run down to 0 instantly
+        if (time_left <= 0)
         {
-            // if the monster is not exposed, the disguise will be drawn
-            disguise->draw();
+            timer_out(npcs, monster);
+        }
+
+        if (player.get_health() <= 0)
+        {
+            game_lost = true;
+        }
+        else if (monster.get_health() <= 0)
+        {
+            game_won = true;
+        }
+
+        // every job has finished, so the room's tiles can be trimmed to the chunks used recently
+        room.trim_tiles();
+    }
+
+    // draw the level onto the window, the characters are drawn between the last update and the next by how far the clock is
+    void draw()
+    {
+        draw(game_timing.get_interpolation());
+    }
+
+    // draw the level with the characters interpolation (0 to 1) of the way from where the update before the last left them to where the last update did
+    void draw(double interpolation)
+    {
+        TRACE_ZONE("draw");
+
+        // clear screen
+        clear_screen(room.get_color_pattern()[2]);
+
+        // setting the camera's zoom level and position to the player's drawn center position
+        coordinate drawn_position = player.get_drawn_position(interpolation);
+        coordinate center = player.get_center_position();
+        camera.update(game_size, {center.x + drawn_position.x - player.get_position().x, center.y + drawn_position.y - player.get_position().y});
 
-            // drawing the outline of the disguise, if show_outline is true, the outline has an easing effect for its visibility
-            if (show_outline)
+        // drawing the room, npcs, player, and monster
+        room.draw(camera);
+        {
+            TRACE_ZONE("character draw");
+            npcs.draw(camera, sprite_batch, interpolation); // only draws the npcs that are on the screen
+            // only draw the player if it is on the screen
+            if (camera.is_visible(player.get_hurtbox()))
             {
-                fill_rectangle(rgba_color(150.0, 170.0, 200.0, ease.ease_value(0.5, delta_time)), disguise->get_hurtbox());
+                player.draw(camera, sprite_batch, interpolation);
             }
-            else
+            // only draw the monster if it is on the screen
+            bool monster_visible = camera.is_visible(monster.get_hurtbox());
+            if (monster_visible)
+            {
+                monster.draw(camera, sprite_batch, interpolation);
+            }
+            sprite_batch.submit();
+
+            if (monster_visible)
+            {
+                monster.draw_outline(camera, tweens.get_value(outline_tween), interpolation);
+            }
+        }
+
+        draw_ability(*vignette, focusing, tweens.get_value(filter_tween));
+
+        {
+            TRACE_ZONE("hud text");
+            if (level_text == -1)
+            {
+                level_text = add_level_text(hud_text, game_level, game_size.get_screen_height());
+                control_text = add_control_text(hud_text, game_size.get_screen_height());
+            }
+
+            // draw for the first 3 seconds of the game
+            if (time_left >= time_limit - 3000)
             {
-                fill_rectangle(rgba_color(150.0, 170.0, 200.0, ease.ease_value(0.0, delta_time)), disguise->get_hurtbox());
+                // drawing the level text on the screen
+                draw_level_text(hud_text, level_text, game_size.get_screen_width(), game_size.get_screen_height());
+                // drawing the control text on the screen
+                draw_control_text(hud_text, control_text, game_size.get_screen_width(), game_size.get_screen_height());
             }
+
+            // drawing the timer countdown on the screen
+            draw_timer(hud_text, time_left / 1000, game_size.get_screen_width(), game_size.get_screen_height());
         }
+
+        draw_count_down_warning(*vignette, time_left, 30000, warning_color_array[2], tweens.get_value(warning_tween));
     }
 
-    // check if the monster's hitbox is colliding with a hitbox
-    void check_hitbox_collision(const rectangle &hitbox)
+    // reporting the path finder's work for the level
+    void report_path_finder() const
     {
-        if (expose_self)
+        if (frame_count > 0)
         {
-            character_data::check_hitbox_collision(hitbox);
+            write_line("Path finder: " + std::to_string(path_query_count) + " queries over " + std::to_string(frame_count) + " frames, " +
+                       std::to_string((double)path_query_count / frame_count) + " queries and " + std::to_string(path_query_time / frame_count) + " ms per frame");
         }
-        else
+    }
+
+    // reporting the sprites drawn each frame for the level
+    void report_sprite_batch() const
+    {
+        sprite_batch.report();
+    }
+
+    // hash of everything the updates decide (the characters, the timer and the eased effects), the same ticks always give the same hash
+    unsigned long long get_state_hash() const
+    {
+        unsigned long long hash = hash_state(0ULL, (unsigned long long)(game_won | game_lost << 1 | timer_over << 2));
+        hash = hash_state(hash, level_time);
+        hash = hash_state(hash, time_left);
+        hash = hash_state(hash, tweens.get_value(time_rate_tween));
+        hash = hash_state(hash, tweens.get_value(zoom_level_tween));
+
+        hash = hash_state(hash, player.get_position().x);
+        hash = hash_state(hash, player.get_position().y);
+        hash = hash_state(hash, (unsigned long long)player.get_health());
+        hash = hash_state(hash, monster.get_position().x);
+        hash = hash_state(hash, monster.get_position().y);
+        hash = hash_state(hash, (unsigned long long)monster.get_health());
+        for (int i = 0; i < npcs.get_count(); i++)
         {
-            disguise->check_hitbox_collision(hitbox);
+            coordinate position = npcs.get_position(i);
+            hash = hash_state(hash, position.x);
+            hash = hash_state(hash, position.y);
+            hash = hash_state(hash, (unsigned long long)npcs.get_health(i));
         }
+        return hash;
     }
 
-    // getters and setters
-    void set_show_outline(bool show_outline)
+    // getters
+    bool is_won() const
     {
-        this->show_outline = show_outline;
+        return game_won;
     }
 
-    void set_expose_self(bool expose_self)
+    bool is_lost() const
     {
-        this->expose_self = expose_self;
+        return game_lost;
     }
 
-    const rectangle &get_hitbox() const
+    bool is_over() const
     {
-        return hitbox;
+        return game_won || game_lost;
     }
 };
 
-// function to calculate and change position of player
-void move_player(player_data &player, double delta_time, const room_data &room)
+// the sprite pack made by --pack-sprites for the images in a folder
+string sprite_pack_path(const string &folder)
 {
-    // calculating distance using delta_time to avoid game lag issues
-    double distance = player.get_speed() * delta_time;
+    return folder + "/sprites.pack";
+}
 
-    // setting the direction of the movement
-    vector_2d direction = {0, 0};
+// add the game's images to the registry without loading them, from the folder's sprite pack or from the png files when there is no up to date pack
+// only reads files, so it can run on another thread while the window opens, returns false if an image the levels use is missing
+bool index_sprites(sprite_registry_data &sprites, const string &folder = "./image_data")
+{
+    const string REQUIRED[] = {"vignette", "player_idle", "sword_1", "sword_2", "npc_idle", "monster"};
 
-    if (key_down(W_KEY))
-    {
-        direction.y -= 1;
-    }
-    if (key_down(S_KEY))
+    if (!sprites.add_pack(sprite_pack_path(folder)))
     {
-        direction.y += 1;
+        sprites.add_folder(folder);
     }
-    if (key_down(A_KEY))
+
+    for (const string &name : REQUIRED)
     {
-        direction.x -= 1;
-        player.set_is_facing_right(false);
+        if (sprites.find(name) == -1)
+        {
+            return false;
+        }
     }
-    if (key_down(D_KEY))
+    return true;
+}
+
+// load the bitmaps needed for the first frame and pack them into the atlas, returns false if one could not be loaded
+// the character sprites are all this small, bigger images (the vignette) are loaded later with load_bitmaps
+bool load_first_sprites(sprite_registry_data &sprites)
+{
+    const int ATLAS_WIDTH = 256;      // pixels
+    const int ATLAS_SPRITE_SIZE = 64; // pixels, sprites bigger than this keep their own bitmap
+
+    if (!sprites.load_bitmaps(ATLAS_SPRITE_SIZE))
     {
-        direction.x += 1;
-        player.set_is_facing_right(true);
+        return false;
     }
+    sprites.build_atlas(ATLAS_WIDTH, ATLAS_SPRITE_SIZE);
+    return true;
+}
 
-    // call move function in chacter_data to move along the direction and distance
-    player.move(direction, distance, room);
+// add and load all of the game's images, returns false if one could not be loaded
+bool load_sprites(sprite_registry_data &sprites)
+{
+    return index_sprites(sprites) && load_first_sprites(sprites) && sprites.load_bitmaps();
 }
 
-// controls the player's attack, calls the player to attack if button is pressed
-void player_attack(player_data &player)
+// play the game in a window, the seed decides the rooms
+// the game is updated at a fixed tick rate and drawn at the frame rate, sleeping between frames
+// with a record_path the controls of every tick are saved to a replay file when the game is closed
+int run_game(unsigned long long seed, const string &record_path = "")
 {
-    if ((key_down(SPACE_KEY) || mouse_clicked(LEFT_BUTTON)))
+    // set up game variables
+    const int WINDOW_WIDTH = 1920;
+    const int WINDOW_HEIGHT = 1080;
+    const int TICK_RATE = 60;              // updates for each second of game time
+    const int FRAME_RATE = 120;            // frames drawn each second
+    const int IDLE_WAIT = 50;              // ms between checking the keys when the game is waiting on the end screen
+    // a recorded game finds every path on the update it is requested, a time budget would make the replay depend on the computer's speed
+    const double PATH_FINDER_BUDGET = record_path.empty() ? 1.0 : HUGE_VAL; // ms
+
+    // when built with tracing, frames slower than the budget (ms) save the last seconds of zones
+    TRACE_FLIGHT_RECORDER(2000.0 / FRAME_RATE, 5); // twice the frame time (ms), 5 s of history
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]
+    { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(); };
+
+    // indexing the images while the window opens, then loading the ones the first frame needs (the rest are loaded after it)
+    sprite_registry_data sprites(false);
+    std::future<bool> indexed = std::async(std::launch::async, [&sprites]
+                                           { return index_sprites(sprites); });
+    open_window("Find The Fake", WINDOW_WIDTH, WINDOW_HEIGHT);
+    double window_time = elapsed();
+    if (!indexed.get() || !load_first_sprites(sprites))
     {
-        player.attack();
+        write_line("Could not load the images in ./image_data");
+        return 1;
     }
-}
+    double load_time = elapsed();
+    bool first_frame = true;
 
-// function to draw the vignette on the screen
-void draw_vignette(double scale = 1)
-{
-    // camera position
-    point_2d camera_pos = camera_position();
+    create_timer("Main timer");
+    start_timer("Main timer");
+    int game_level = 1; // starts at level 1, increases by 1 each level
 
-    // lengths and widths
-    double vignette_width = bitmap_width("vignette");
-    double vignette_height = bitmap_height("vignette");
-    double screen_x = screen_width();
-    double screen_y = screen_height();
+    job_system_data job_system;               // worker threads for the npc updates, kept for every level
+    random_stream_data random(seed);
+    input_recording_data recording(seed);
+    write_line("Seed: " + std::to_string(seed)); // so a game can be played again with --seed
 
-    // scaling the vignette to fit the screen and custom scaling
-    double scale_x = (screen_x / vignette_width) * scale;
-    double scale_y = (screen_y / vignette_height) * scale;
+    while (!quit_requested())
+    {
+        int room_width = random.next_int(20, 60);
+        int room_height = random.next_int(20, 60);
+        level_data level(game_level, WINDOW_WIDTH, WINDOW_HEIGHT, room_width, room_height, TICK_RATE, PATH_FINDER_BUDGET, sprites, random.next());
+        frame_pacer_data frame_pacer(FRAME_RATE);
+        bool attack_pending = false; // a click in a frame without an update is kept for the next update
 
-    // getting the camera's cetner
-    double camera_center_x = camera_pos.x + (screen_x / 2);
-    double camera_center_y = camera_pos.y + (screen_y / 2);
+        // game loop
+        while (!quit_requested())
+        {
+            TRACE_BEGIN_FRAME();
 
-    // getting the distance of the center of the vignette
-    double vignette_center_x = (vignette_width * scale_x) / 2;
-    double vignette_center_y = (vignette_height * scale_y) / 2;
+            // running the updates for the time passed since the last frame (can be none when the frame rate is above the tick rate)
+            level.advance_clock(timer_ticks("Main timer"));
+            input_data input = read_input();
+            input.attack = input.attack || attack_pending;
 
-    // getting the x and y position to draw the vignette (with aligning error fix from bitmap scaling)
-    double x = (camera_center_x - vignette_center_x) + (((vignette_width * scale_x) - vignette_width) / 2);
-    double y = (camera_center_y - vignette_center_y) + (((vignette_height * scale_y) - vignette_height) / 2);
+            bool updated = false;
+            while (!level.is_over() && level.update(input, &job_system))
+            {
+                updated = true;
+                if (!record_path.empty())
+                {
+                    recording.record_tick(input, level.get_state_hash());
+                }
+            }
+            attack_pending = input.attack && !updated;
 
-    draw_bitmap("vignette", x, y, (option_scale_bmp(scale_x, scale_y)));
-}
+            level.draw();
 
-// control to slow time, used for the focusing ability
-void control_ability(game_timing_data &game_timing, game_size_data &game_size, monster_data &monster, ease_data &time_rate_ease, ease_data &zoom_level_ease, ease_data &filter_ease)
-{
-    point_2d camera_pos = camera_position();
+            if (level.is_over())
+            {
+                break;
+            }
 
-    if (key_down(LEFT_SHIFT_KEY) || mouse_down(RIGHT_BUTTON))
-    {
-        // slowing time and zooming in with easing
-        game_timing.set_time_rate(0.35, time_rate_ease, game_timing.get_time_difference());
-        game_size.set_zoom_level(2.5, zoom_level_ease, game_timing.get_time_difference());
+            refresh_screen();
+            process_events();
+            TRACE_END_FRAME();
 
-        // drawing effects on screen
-        // vignetted screen
-        draw_vignette();
-        // color to desaturate the screen
-        fill_rectangle(rgba_color(150.0, 170.0, 200.0, filter_ease.ease_value(0.5, game_timing.get_time_difference())), camera_pos.x, camera_pos.y, screen_width(), screen_height());
-        // outline or highlight the monster
-        monster.set_show_outline(true);
-    }
-    else
-    {
-        // returning time and zoom to normal with easing
-        game_timing.set_time_rate(1, time_rate_ease, game_timing.get_time_difference());
-        game_size.set_zoom_level(1, zoom_level_ease, game_timing.get_time_difference());
+            // loading the rest of the images (the vignette) once the first frame is on the screen
+            // the level's clock skips the time spent loading, so the game does not lose it or race to catch up
+            if (first_frame)
+            {
+                first_frame = false;
+                write_line("Time to first frame: " + std::to_string(elapsed()) + " ms (window open at " + std::to_string(window_time) + " ms, first images loaded at " + std::to_string(load_time) + " ms)");
+                if (!sprites.load_bitmaps())
+                {
+                    write_line("Could not load the images in ./image_data");
+                    return 1;
+                }
+                level.resync_clock(timer_ticks("Main timer"));
+            }
+            frame_pacer.wait();
+        }
 
-        // removing destauration on screen
-        fill_rectangle(rgba_color(150.0, 170.0, 200.0, filter_ease.ease_value(0.0, game_timing.get_time_difference())), camera_pos.x, camera_pos.y, screen_width(), screen_height());
-        monster.set_show_outline(false);
-    }
-}
+        level.report_path_finder();
+        level.report_sprite_batch();
 
-// function to control character, must be called in the game loop
-void control_player(player_data &player, game_timing_data &game_timing, const room_data &room)
-{
-    move_player(player, game_timing.get_delta_time(), room);
-    player_attack(player);
-}
+        if (level.is_won())
+        {
+            game_level++;
+            draw_end_screen("Level Complete!", "Press Esc to continue", rgba_color(255.0, 255.0, 255.0, 0.5), WINDOW_WIDTH, WINDOW_HEIGHT);
+        }
 
-// function to contol counter for the game, minimum is 0
-double timer_countdown(int time_limit, bool timer_over)
-{
-    if (timer_over)
-    {
-        return 0;
-    }
+        if (level.is_lost())
+        {
+            game_level = 1;
+            draw_end_screen("Game Over!", "Press Esc to restart", rgba_color(139.0, 0.0, 0.0, 0.5), WINDOW_WIDTH, WINDOW_HEIGHT);
+        }
 
-    double timer = (double)time_limit - (double)timer_ticks("Main timer");
-    if (timer <= 0)
-    {
-        timer = 0;
-    }
-    return timer;
-}
+        refresh_screen();
 
-// change color of the room as timer goes down, change from initial color to new color array
-void change_color(double time_left, int time_start_warning, room_data &room, color initial_color_array[3], color new_color_array[3])
-{
-    // floor 1
-    float floor_1_r_change = (new_color_array[0].r - initial_color_array[0].r) * (1 - (time_left / time_start_warning));
-    float floor_1_g_change = (new_color_array[0].g - initial_color_array[0].g) * (1 - (time_left / time_start_warning));
-    float floor_1_b_change = (new_color_array[0].b - initial_color_array[0].b) * (1 - (time_left / time_start_warning));
-    color floor_1_change = rgb_color(initial_color_array[0].r + floor_1_r_change, initial_color_array[0].g + floor_1_g_change, initial_color_array[0].b + floor_1_b_change);
-
-    // floor 2
-    float floor_2_r_change = (new_color_array[1].r - initial_color_array[1].r) * (1 - (time_left / time_start_warning));
-    float floor_2_g_change = (new_color_array[1].g - initial_color_array[1].g) * (1 - (time_left / time_start_warning));
-    float floor_2_b_change = (new_color_array[1].b - initial_color_array[1].b) * (1 - (time_left / time_start_warning));
-    color floor_2_change = rgb_color(initial_color_array[1].r + floor_2_r_change, initial_color_array[1].g + floor_2_g_change, initial_color_array[1].b + floor_2_b_change);
-
-    // wall
-    float wall_r_change = (new_color_array[2].r - initial_color_array[2].r) * (1 - (time_left / time_start_warning));
-    float wall_g_change = (new_color_array[2].g - initial_color_array[2].g) * (1 - (time_left / time_start_warning));
-    float wall_b_change = (new_color_array[2].b - initial_color_array[2].b) * (1 - (time_left / time_start_warning));
-    color wall_change = rgb_color(initial_color_array[2].r + wall_r_change, initial_color_array[2].g + wall_g_change, initial_color_array[2].b + wall_b_change);
-
-    // setting the new color as timer goes down
-    room.set_color_pattern(floor_1_change, floor_2_change, wall_change);
-}
+        // nothing changes on the end screen, so the game sleeps between checking the keys
+        while (!quit_requested() && !key_typed(ESCAPE_KEY))
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_WAIT));
+            process_events();
+        }
+
+        reset_timer("Main timer");
+        process_events();
+    }
 
-// visual warnings as timer goes down, change color and draw vignette zooming in
-void count_down_warning(double time_left, int time_start_warning, room_data &room, color initial_color_array[3], ease_data &ease, double delta_time)
-{
-    if (time_left < time_start_warning)
+    TRACE_EXPORT("trace.json");
+    if (!record_path.empty())
     {
-        color new_color_array[3] = {
-            rgb_color(0, 0, 0),
-            rgb_color(68, 68, 68),
-            rgb_color(139, 0, 0),
-        };
-        change_color(time_left, time_start_warning, room, initial_color_array, new_color_array);
-
-        // vignette zooming in as timer goes down, from initial scale to final scale
-        double initial_vignette_scale = 5;
-        double final_vignette_scale = 1.5;
-        double scale = initial_vignette_scale - ((initial_vignette_scale - final_vignette_scale) * (1 - (time_left / time_start_warning)));
-        draw_vignette(scale);
-        if (time_left <= 0)
+        if (!recording.write(record_path))
         {
-            point_2d camera_pos = camera_position();
-            fill_rectangle(rgba_color(new_color_array[2].r, new_color_array[2].g, new_color_array[2].b, ease.ease_value(0.1, delta_time)), camera_pos.x, camera_pos.y, screen_width(), screen_height());
+            write_line("Could not write the replay " + record_path);
+            return 1;
         }
+        write_line("Recorded " + std::to_string(recording.get_tick_count()) + " ticks to " + record_path);
     }
+    return 0;
 }
 
-// function to draw the timer on the screen
-void draw_timer(double time_left, double window_width, double window_height)
+// play the game in a window for a number of seconds with made up controls, drawing a frame for each tick with no frame rate cap
+// reports the most ticks per second the game can run while drawing
+int run_benchmark(double seconds, unsigned long long seed)
 {
-    // drawing the time left on the screen (timer countdown)
-    string time_left_string = std::to_string(time_left);
-
-    int tailing_decmials = 4; // number of decimal places to show including the dot
+    const int WINDOW_WIDTH = 1920;
+    const int WINDOW_HEIGHT = 1080;
+    const int TICK_RATE = 60;
+    const double TICK_TIME = 1000.0 / TICK_RATE; // ms
 
-    // number of digits of the integer part of the time left
-    int int_digits;
-    if (time_left >= 10)
-    {
-        int_digits = 2; // numbers larger than or equal to 10 has 2 digits
-    }
-    if (time_left < 10)
+    sprite_registry_data sprites(false);
+    if (!load_sprites(sprites))
     {
-        int_digits = 1; // numbers smaller than 10 has 1 digit
+        write_line("Could not load the images in ./image_data");
+        return 1;
     }
 
-    time_left_string = time_left_string.substr(0, int_digits + tailing_decmials);
-
-    double font_size = window_height * 0.05;
-
-    int text_h = text_height(time_left_string, get_system_font(), font_size);
-    int text_w = text_width(time_left_string, get_system_font(), font_size);
-
-    double text_pos_x = camera_position().x + ((double)window_width / 2.0);
-    double text_pos_y = camera_position().y + ((double)font_size);
+    open_window("Find The Fake (benchmark)", WINDOW_WIDTH, WINDOW_HEIGHT);
 
-    double text_center_x = text_pos_x - (text_w / 2);
-    double text_center_y = text_pos_y - (text_h / 2);
-
-    draw_text(time_left_string, color_white(), get_system_font(), font_size, text_center_x, text_center_y);
-}
+    job_system_data job_system;
+    random_stream_data random(seed);
+    scripted_input_data input(random.next());
 
-// function to handle game when the timer is out
-void timer_out(vector<npc_data *> &npcs, monster_data &monster)
-{
-    // if the timer is out, the monster will be exposed
-    monster.set_expose_self(true);
+    int game_level = 1;
+    int ticks = 0;
+    int frames = 0;
+    double update_time = 0; // ms
+    double draw_time = 0;   // ms
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]
+    { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
 
-    // if the timer is out, the npcs will be exposed
-    for (int i = 0; i < npcs.size(); i++)
+    while (elapsed() < seconds && !quit_requested())
     {
-        npcs[i]->set_health(0);
-    }
-}
+        int room_width = random.next_int(20, 60);
+        int room_height = random.next_int(20, 60);
+        level_data level(game_level, WINDOW_WIDTH, WINDOW_HEIGHT, room_width, room_height, TICK_RATE, HUGE_VAL, sprites, random.next());
 
-// function to draw the level text onto the screen
-void draw_level_text(int game_level, double window_width, double window_height)
-{
-    // drawing the level text on the screen
-    string level_text = "Level " + std::to_string(game_level);
-    double font_size = window_height * 0.025;
+        // the clock moves a tick each frame, so the game runs as fast as it can be updated and drawn
+        double clock = 0; // ms since the level started
+        while (!level.is_over() && elapsed() < seconds && !quit_requested())
+        {
+            TRACE_BEGIN_FRAME();
+            auto frame_start = std::chrono::steady_clock::now();
+            clock += TICK_TIME;
+            level.advance_clock(clock);
+            while (!level.is_over() && level.update(input.update(TICK_TIME), &job_system))
+            {
+                ticks++;
+            }
 
-    int text_h = text_height(level_text, get_system_font(), font_size);
-    int text_w = text_width(level_text, get_system_font(), font_size);
+            auto draw_start = std::chrono::steady_clock::now();
+            level.draw();
+            refresh_screen();
+            process_events();
+            frames++;
+            TRACE_END_FRAME();
 
-    double text_pos_x = camera_position().x + ((double)window_width / 2.0);
-    double text_pos_y = camera_position().y + ((double)window_height * 0.1);
+            update_time += std::chrono::duration<double, std::milli>(draw_start - frame_start).count();
+            draw_time += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - draw_start).count();
+        }
 
-    double text_center_x = text_pos_x - (text_w / 2);
-    double text_center_y = text_pos_y - (text_h / 2);
+        level.report_sprite_batch();
+        game_level = level.is_won() ? game_level + 1 : 1;
+    }
 
-    draw_text(level_text, color_white(), get_system_font(), font_size, text_center_x, text_center_y);
+    TRACE_EXPORT("trace.json");
+    double total_seconds = elapsed();
+    write_line("Benchmark: " + std::to_string(ticks) + " ticks and " + std::to_string(frames) + " frames in " + std::to_string(total_seconds) + " s, " +
+               std::to_string(ticks / total_seconds) + " ticks per second");
+    if (frames > 0)
+    {
+        write_line("Updating " + std::to_string(update_time / frames) + " ms and drawing " + std::to_string(draw_time / frames) + " ms per frame");
+    }
+    return 0;
 }
 
-// function to draw the game's control info on the screen
-void draw_control_text(double window_width, double window_height)
+// check gameplay rules that have broken before, without a window, returns 1 if one of them fails
+int run_checks()
 {
-    // drawing the control text on the screen
-    string control_text = "WASD to move | Space/Left Click to attack | Shift/Right Click to focus";
-    double font_size = window_height * 0.015;
+    const int SCREEN_WIDTH = 1920; // the room's tile size depends on the screen size
+    const int SCREEN_HEIGHT = 1080;
+    const double TICK_TIME = 1000.0 / 60; // ms
 
-    int text_h = text_height(control_text, get_system_font(), font_size);
-    int text_w = text_width(control_text, get_system_font(), font_size);
+    sprite_registry_data sprites(true);
+    if (!load_sprites(sprites))
+    {
+        write_line("Could not read the images in ./image_data");
+        return 1;
+    }
 
-    double text_pos_x = camera_position().x + ((double)window_width * 0.5);
-    double text_pos_y = camera_position().y + ((double)window_height * 0.95);
+    int failed = 0;
+    auto check = [&failed](bool passed, const string &name)
+    {
+        write_line((passed ? "ok: " : "FAILED: ") + name);
+        failed += passed ? 0 : 1;
+    };
 
-    double text_center_x = text_pos_x - (text_w / 2);
-    double text_center_y = text_pos_y - (text_h / 2);
+    // an idle player (its hitbox is 0 x 0 at its corner) standing with that corner inside an npc does not hurt it
+    {
+        room_data room(20, 20, SCREEN_WIDTH, SCREEN_HEIGHT);
+        npc_store_data npcs(1, room.get_tile_size(), room.get_tile_size(), room, sprites.get(sprites.find("npc_idle")), 1);
+        auto make_player = [&](const coordinate &position)
+        { return player_data(room.get_tile_size(), room.get_tile_size(), position, sprites.get(sprites.find("player_idle")), sprites.get(sprites.find("sword_1")), sprites.get(sprites.find("sword_2"))); };
+
+        // placing the player so the corner its hitbox is at (its right edge when facing right) is in the middle of the npc
+        rectangle hurtbox = npcs.get_hurtbox(0);
+        player_data spawned_player = make_player(room.get_spawn_coords());
+        double hitbox_offset = spawned_player.get_hitbox().x - spawned_player.get_position().x;
+        player_data player = make_player({hurtbox.x + hurtbox.width / 2 - hitbox_offset, hurtbox.y + hurtbox.height / 2});
+        player.update(TICK_TIME);
+
+        int health = npcs.get_health(0);
+        npcs.check_hitbox_collision(player.get_hitbox());
+        check(player.get_hitbox().width == 0 && npcs.get_health(0) == health, "an idle player overlapping an npc does not hurt it");
+    }
 
-    draw_text(control_text, color_white(), get_system_font(), font_size, text_center_x, text_center_y);
+    write_line(std::to_string(failed) + " checks failed");
+    return failed == 0 ? 0 : 1;
 }
 
-// draw the end screen, either game won or game lost
-void draw_end_screen(string text, string sub_text, const color &bg_color, double window_width, double window_height)
+// run the game without a window for tick_count updates, as fast as the computer can
+// each update is a tick of game time and the controls are made up, so the same seed always plays the same game
+int run_headless(int tick_count, unsigned long long seed)
 {
-    // setting font sizes
-    double font_size = window_height * 0.15;
-    double font_size_small = font_size * 0.2;
+    const int SCREEN_WIDTH = 1920; // the room's tile size depends on the screen size
+    const int SCREEN_HEIGHT = 1080;
+    const int TICK_RATE = 60;
+    const double TICK_TIME = 1000.0 / TICK_RATE; // ms
 
-    // setting the position of the text according to the camera
-    double pos_x = camera_position().x + ((double)window_width / 2.0);
-    double pos_y = camera_position().y + ((double)window_height / 3.0);
+    sprite_registry_data sprites(true);
+    if (!load_sprites(sprites))
+    {
+        write_line("Could not read the images in ./image_data");
+        return 1;
+    }
 
-    // pos_y2 is for the subtext
-    double pos_y2 = camera_position().y + (((double)window_height / 3.0) * 2);
-    // text and subtext will have the same x position
+    job_system_data job_system;
+    random_stream_data random(seed);
+    scripted_input_data input(random.next());
 
-    double text_h = text_height(text, get_system_font(), font_size);
-    double text_w = text_width(text, get_system_font(), font_size);
+    int game_level = 1;
+    int levels_won = 0;
+    int levels_lost = 0;
+    int ticks = 0;
+    auto start = std::chrono::steady_clock::now();
 
-    double text_center_x = pos_x - (text_w / 2);
-    double text_center_y = pos_y - (text_h / 2);
+    while (ticks < tick_count)
+    {
+        int room_width = random.next_int(20, 60);
+        int room_height = random.next_int(20, 60);
+        // no path finder budget, a time budget would make the game depend on the computer's speed
+        level_data level(game_level, SCREEN_WIDTH, SCREEN_HEIGHT, room_width, room_height, TICK_RATE, HUGE_VAL, sprites, random.next());
 
-    double sub_text_h = text_height(sub_text, get_system_font(), font_size_small);
-    double sub_text_w = text_width(sub_text, get_system_font(), font_size_small);
+        while (ticks < tick_count && !level.is_over())
+        {
+            TRACE_BEGIN_FRAME();
+            level.update_tick(input.update(TICK_TIME), &job_system);
+            ticks++;
+            TRACE_END_FRAME();
+        }
 
-    double sub_text_center_x = pos_x - (sub_text_w / 2);
-    double sub_text_center_y = pos_y2 - (sub_text_h / 2);
+        if (level.is_won())
+        {
+            levels_won++;
+            game_level++;
+        }
+        if (level.is_lost())
+        {
+            levels_lost++;
+            game_level = 1;
+        }
+    }
 
-    fill_rectangle(bg_color, camera_position().x, camera_position().y, window_width, window_height);
-    draw_text(text, color_white(), get_system_font(), font_size, text_center_x, text_center_y);
-    draw_text(sub_text, color_white(), get_system_font(), font_size_small, sub_text_center_x, sub_text_center_y);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TRACE_EXPORT("trace.json");
+    write_line("Headless: " + std::to_string(ticks) + " ticks (" + std::to_string(ticks * TICK_TIME / 1000) + " s of game time) in " +
+               std::to_string(seconds) + " s, " + std::to_string(ticks / seconds) + " ticks per second");
+    write_line("Levels won: " + std::to_string(levels_won) + ", levels lost: " + std::to_string(levels_lost) + ", reached level " + std::to_string(game_level));
+    return 0;
 }
 
-// generate random walls in the room
-void generate_random_walls(room_data &room, int wall_count)
+// play a recorded game again from its replay file, headless as fast as it can go or in a window at the tick rate
+// checks the state of every tick against the recording and reports the first tick that differs, and the slowest ticks to find hitches
+int run_replay(const string &path, bool windowed)
 {
-    // NOTE: all coordinates used in here are tile coorindates, not pixel coordinates
+    const int SCREEN_WIDTH = 1920; // the same size as the window the game was recorded in, the room's tile size depends on it
+    const int SCREEN_HEIGHT = 1080;
+    const int TICK_RATE = 60;
 
-    // vector to store the walls' information (used to create the walls with rooms' set_wall function)
-    vector<rectangle> walls_info;
-    // generating random walls in the room
-    for (int i = 0; i < wall_count; i++)
+    input_recording_data recording;
+    if (!recording.read(path))
     {
-        room.get_spawn_coords();
-        double wall_width = rnd(room.get_size_x() / 12, room.get_size_x() / 3);                                             // random width of the wall
-        double wall_height = rnd(room.get_size_y() / 12, room.get_size_y() / 3);                                            // random height of the wall
-        coordinate wall_pos = random_coordinate({0, 0}, {room.get_size_x() - wall_width, room.get_size_y() - wall_height}); // random position of the wall
-
-        walls_info.push_back({wall_pos.x, wall_pos.y, wall_width, wall_height}); // storing the wall's information
+        write_line("Could not read the replay " + path);
+        return 1;
     }
 
-    // expanding the walls by 1 tile, for checking collision
-    // walls cannot be closer than 2 tiles to each other
-    for (int i = 0; i < walls_info.size(); i++)
+    sprite_registry_data sprites(!windowed);
+    if (!load_sprites(sprites))
+    {
+        write_line("Could not read the images in ./image_data");
+        return 1;
+    }
+    if (windowed)
     {
-        walls_info[i].x -= 1;
-        walls_info[i].y -= 1;
-        walls_info[i].width += 2;
-        walls_info[i].height += 2;
+        open_window("Find The Fake (replay)", SCREEN_WIDTH, SCREEN_HEIGHT);
     }
 
-    // creating a rectangle around the spawn tile
-    coordinate spawn_coords = room.get_spawn_coords();
-    coordinate spawn_tile = spawn_coords.pixel_to_tile(room.get_tile_size());
-    // the radius of the rectangle around the spawn tile
-    double spawn_radius = 3;
-    rectangle spawn_rectangle = {spawn_tile.x - spawn_radius, spawn_tile.y - spawn_radius, spawn_radius * 2.0, spawn_radius * 2.0};
+    // the levels are made in the same order as the recorded game, from the same game seed
+    job_system_data job_system;
+    random_stream_data random(recording.get_seed());
+    frame_pacer_data frame_pacer(TICK_RATE);
+
+    int game_level = 1;
+    int tick = 0;
+    int diverged_tick = -1;
+    unsigned long long rolling_hash = 0;
+    int slowest_tick = 0;
+    double slowest_tick_time = 0; // ms
+    auto start = std::chrono::steady_clock::now();
 
-    // removing walls that intersect with the spawn rectangle, or intersect with each other (note the walls are expanded by 1 tile)
-    for (int i = 0; i < walls_info.size(); i++)
+    while (tick < recording.get_tick_count() && !(windowed && quit_requested()))
     {
-        for (int j = 0; j < walls_info.size(); j++)
+        int room_width = random.next_int(20, 60);
+        int room_height = random.next_int(20, 60);
+        level_data level(game_level, SCREEN_WIDTH, SCREEN_HEIGHT, room_width, room_height, TICK_RATE, HUGE_VAL, sprites, random.next());
+
+        while (tick < recording.get_tick_count() && !level.is_over() && !(windowed && quit_requested()))
         {
-            if (i == j)
+            TRACE_BEGIN_FRAME();
+            auto tick_start = std::chrono::steady_clock::now();
+            level.update_tick(recording.get_input(tick), &job_system);
+            double tick_time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tick_start).count();
+            if (tick_time > slowest_tick_time)
             {
-                continue;
+                slowest_tick_time = tick_time;
+                slowest_tick = tick;
+            }
+
+            rolling_hash = input_recording_data::roll_hash(rolling_hash, level.get_state_hash());
+            if (diverged_tick == -1 && !recording.matches(tick, rolling_hash))
+            {
+                diverged_tick = tick;
+                write_line("Replay diverged at tick " + std::to_string(tick));
             }
+            tick++;
 
-            // checking if the walls intersect with the spawn rectangle or each other (note that touching counts as intersecting)
-            if (rectangles_intersect(walls_info[j], spawn_rectangle) || rectangles_intersect(walls_info[i], walls_info[j]))
+            // the clock is not advanced, so the level is drawn with an interpolation of 1 to show the characters where the last update left them
+            if (windowed)
             {
-                // if the walls intersect, remove the wall (by setting the sizes to 0)
-                walls_info[j].width = 0;
-                walls_info[j].height = 0;
+                level.draw(1);
+                refresh_screen();
+                process_events();
+                frame_pacer.wait();
             }
+            TRACE_END_FRAME();
         }
+
+        game_level = level.is_won() ? game_level + 1 : level.is_lost() ? 1 : game_level;
     }
 
-    // shrinking the walls back to their original size (by 1 tile)
-    for (int i = 0; i < walls_info.size(); i++)
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TRACE_EXPORT("trace.json");
+    write_line("Replay: " + std::to_string(tick) + " of " + std::to_string(recording.get_tick_count()) + " ticks in " + std::to_string(seconds) + " s, " +
+               std::to_string(tick / seconds) + " ticks per second, slowest tick " + std::to_string(slowest_tick) + " took " + std::to_string(slowest_tick_time) + " ms");
+    if (diverged_tick != -1)
     {
-        walls_info[i].x += 1;
-        walls_info[i].y += 1;
-        walls_info[i].width -= 2;
-        walls_info[i].height -= 2;
+        return 1;
     }
+    write_line("Every tick matched the recording");
+    return 0;
+}
 
-    // setting the walls in the room
-    for (int i = 0; i < walls_info.size(); i++)
+// write the sprite pack for the images in a folder, so the game can index them from one file instead of reading every png
+// the game goes back to reading the png files while the pack is older than the images, until it is written again
+int run_sprite_packer(const string &folder)
+{
+    sprite_registry_data sprites(true);
+    int count = sprites.add_folder(folder);
+    if (count == 0 || !sprites.write_pack(sprite_pack_path(folder)))
     {
-        // if the width or height is 0, the wall is not set
-        if (walls_info[i].width > 0 || walls_info[i].height > 0)
-        {
-            room.set_wall({walls_info[i].x, walls_info[i].y}, {walls_info[i].x + walls_info[i].width, walls_info[i].y + walls_info[i].height});
-        }
+        write_line("Could not write the sprite pack for the images in " + folder);
+        return 1;
     }
+
+    write_line("Packed " + std::to_string(count) + " images into " + sprite_pack_path(folder));
+    return 0;
 }
 
-int main()
+// generate the walls of a size x size room from a seed and report how long it took and how many walls did not fit
+int run_room_generator(int size, double density, unsigned long long seed)
 {
-    // set up game variables
-    const int WINDOW_WIDTH = 1920;
-    const int WINDOW_HEIGHT = 1080;
-    const int FRAME_RATE = 120;
+    const int SCREEN_WIDTH = 1920; // the room's tile size depends on the screen size
+    const int SCREEN_HEIGHT = 1080;
 
-    // load bitmaps
-    load_bitmap("vignette", "./image_data/vignette/vignette.png");
-    load_bitmap("player_idle", "./image_data/player/player_idle.png");
-    load_bitmap("sword_draw", "./image_data/sword/sword_1.png");
-    load_bitmap("sword_swing", "./image_data/sword/sword_2.png");
-    load_bitmap("npc_idle", "./image_data/npc/npc_idle.png");
-    load_bitmap("monster", "./image_data/monster/monster.png");
+    if (size < 1)
+    {
+        write_line("The room needs at least 1 tile");
+        return 1;
+    }
 
-    // open window
-    open_window("Find The Fake", WINDOW_WIDTH, WINDOW_HEIGHT);
-    create_timer("Main timer");
-    start_timer("Main timer");
-    int game_level = 1; // starts at level 1, increases by 1 each level
+    random_stream_data random(seed);
+    room_data room(size, size, SCREEN_WIDTH, SCREEN_HEIGHT);
+    wall_generation_report_data report = generate_random_walls(room, density, random);
 
-    while (!quit_requested())
+    write_line("Generated a " + std::to_string(size) + "x" + std::to_string(size) + " room in " + std::to_string(report.time) + " ms: " +
+               std::to_string(report.placed) + " walls placed, " + std::to_string(report.rejected) + " rejected, " + std::to_string(report.removed) + " removed to keep it connected, " +
+               std::to_string(report.coverage * 100) + "% walls");
+    if (!report.reached_density)
     {
+        write_line("The walls stopped short of " + std::to_string(density * 100) + "% walls, too many walls in a row did not fit");
+    }
+    write_line("Tiles: " + std::to_string(room.get_resident_chunk_count()) + " of " + std::to_string(room.get_chunk_count()) + " chunks in memory, " +
+               std::to_string(room.get_tile_memory() / 1024.0) + " KB (" + std::to_string((double)size * size / 1024) + " KB as a flat array)");
+    return 0;
+}
 
-        int time_limit = 60000;  // ms
-        bool timer_over = false; // when timer_over is true, timer runs down to 0 instantly
-        bool game_won = false;
-        bool game_lost = false;
+#ifdef FTF_BENCHMARK
+// allocations made since the program started, counted by replacing the global operator new (only in benchmark builds)
+std::atomic<long long> allocation_count(0);
 
-        int room_width = rnd(20, 60);
-        int room_height = rnd(20, 60);
-        // time limit for the game, to find the monster
-        // number of npcs in the room
-        int npc_count = game_level + 1; // number of npcs increases by 1 each level
+// the replacements pair malloc with free, gcc cannot see that operator new is replaced too and warns about every delete it inlines
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void *operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
 
-        // creating game objects
-        game_size_data game_size(WINDOW_WIDTH, WINDOW_HEIGHT, room_width, room_height);
-        game_timing_data game_timing(FRAME_RATE);
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
 
-        // building the room object
-        room_data room(game_size.get_room_width(), game_size.get_room_height(), game_size.get_screen_width(), game_size.get_screen_height());
-        generate_random_walls(room, 10); // generating random walls in the room
-        room.set_zoom_level(game_size.get_zoom_level());
-        room.build_room();
-        const color *color_array = room.get_color_pattern();
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#pragma GCC diagnostic pop
+
+// work a benchmark has to do between its operations that is not part of what it measures (such as making a new level)
+// the time and allocations of the work are left out of the benchmark's results
+struct benchmark_untimed_data
+{
+    double seconds;
+    long long allocations;
 
-        double tile_size = room.get_zoomed_tile_size();
+    // do the untimed work
+    template <typename work_function>
+    void run(work_function work)
+    {
+        long long allocations_before = allocation_count.load();
+        auto start = std::chrono::steady_clock::now();
+        work();
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        allocations += allocation_count.load() - allocations_before;
+    }
+};
 
-        // creating player and npc objects
-        double player_model_size = tile_size;
-        player_data player(tile_size, player_model_size, room.get_spawn_coords(), "player_idle");
+// time a benchmark and print it as a csv row (benchmark,parameter,ns per op,allocations per op,ops)
+// run(ops) must do ops operations, it is called with more operations until it takes at least min_time seconds
+// work run through untimed (if given) during run(ops) is left out
+template <typename benchmark_function>
+void run_micro_benchmark(const string &name, const string &parameter, double min_time, benchmark_function run, benchmark_untimed_data *untimed = nullptr)
+{
+    run(1); // warming up caches and lazily built tables
 
-        double npc_model_size = tile_size;
-        vector<npc_data *> npcs(npc_count); // keeping all the npcs in the room in a vector (there are multiple npcs in the room)
-        for (int i = 0; i < npc_count; i++)
+    long long ops = 1;
+    while (true)
+    {
+        if (untimed != nullptr)
         {
-            npcs[i] = new npc_data(tile_size, npc_model_size, room, "npc_idle");
-            npcs[i]->set_zoom_level(game_size.get_zoom_level());
-            npcs[i]->update(game_timing.get_delta_time(), room);
+            *untimed = {0, 0};
+        }
+        long long allocations_before = allocation_count.load();
+        auto start = std::chrono::steady_clock::now();
+        run(ops);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        long long allocations = allocation_count.load() - allocations_before;
+        if (untimed != nullptr)
+        {
+            seconds -= untimed->seconds;
+            allocations -= untimed->allocations;
         }
 
-        // creating monster object
-        double monster_model_size = tile_size * 2.4;
-        monster_data monster(tile_size, npc_model_size, monster_model_size, room, "npc_idle", "monster");
-        monster.set_zoom_level(game_size.get_zoom_level());
-        monster.update(game_timing.get_delta_time(), room, player);
-
-        // setting up easing functions and objects to be used
-        ease_data highlight_ease;
-        highlight_ease.ease_func = &ease_out_quint;
-        highlight_ease.time_to_ease = 10000;
-
-        ease_data time_rate_ease;
-        time_rate_ease.ease_func = &ease_out_quint;
+        if (seconds >= min_time || ops >= (1LL << 40))
+        {
+            write_line(name + "," + parameter + "," + std::to_string(seconds * 1e9 / ops) + "," + std::to_string((double)allocations / ops) + "," + std::to_string(ops));
+            return;
+        }
 
-        ease_data zoom_level_ease;
-        zoom_level_ease.ease_func = &ease_out_quint;
+        // aiming a bit past min_time from the time this run took
+        ops = seconds > 0 ? std::max(ops * 2, (long long)(ops * min_time * 1.2 / seconds)) : ops * 10;
+    }
+}
 
-        ease_data filter_ease;
-        filter_ease.ease_func = &ease_out_quint;
+// run the micro benchmarks whose name contains filter, as csv rows that can be plotted against the parameters
+int run_micro_benchmarks(const string &filter, double min_time)
+{
+    const int SCREEN_WIDTH = 1920;
+    const int SCREEN_HEIGHT = 1080;
+    const int TICK_RATE = 60;
+    const double TICK_TIME = 1000.0 / TICK_RATE; // ms
 
-        ease_data timer_warning_ease;
-        timer_warning_ease.ease_func = &ease_out_quint;
-        timer_warning_ease.time_to_release = 1000;
-        timer_warning_ease.value = 0.7;
+    sprite_registry_data sprites(true);
+    if (!load_sprites(sprites))
+    {
+        write_line("Could not read the images in ./image_data");
+        return 1;
+    }
+    auto selected = [&filter](const string &name)
+    { return filter.empty() || name.find(filter) != string::npos; };
 
-        // initial, unupdated color of room, used to show timer countdown warnings
-        color initial_color_array[3] = {color_array[0], color_array[1], color_array[2]};
+    write_line("benchmark,parameter,ns_per_op,allocations_per_op,ops");
 
-        // game loop
-        while (!quit_requested())
+    // moving a character through rooms with more and more walls: an empty room, the generated rooms the other benchmarks use (density 0.2) across room sizes,
+    // and a room filled with 2x2 pillars, the walls of a generated room are big and kept apart so they stop at a few walls whatever the density
+    if (selected("character_data::move"))
+    {
+        const int PILLAR_ROOM = -1; // in place of a size, the 60x60 room of pillars
+        int sizes[] = {0, 20, 40, 60, 120, 240, PILLAR_ROOM};
+        for (int size : sizes)
         {
-            // setting game timing
-            game_timing.update_timing();
-            // skip frame if no time has passed (fast computers can have time difference of 0)
-            if (game_timing.get_time_difference() == 0)
-            {
-                continue;
-            }
-
-            // clear screen
-            clear_screen(color_array[2]);
-
-            // updating player, npcs, and monster by calling their update functions, setting their zoom level, and checking for hitbox collision
-            for (int i = 0; i < npc_count; i++)
+            random_stream_data random(1);
+            room_data room(size > 0 ? size : 60, size > 0 ? size : 60, SCREEN_WIDTH, SCREEN_HEIGHT);
+            string room_name = size == 0 ? "empty" : size == PILLAR_ROOM ? "pillars" : "size=" + std::to_string(size);
+            int wall_count = 0;
+            if (size > 0)
             {
-                if (npcs[i]->get_health() <= 0)
-                {
-                    timer_over = true;
-                    break;
-                }
-
-                npcs[i]->set_zoom_level(game_size.get_zoom_level());
-                npcs[i]->update(game_timing.get_delta_time(), room);
-                npcs[i]->check_hitbox_collision(player.get_hitbox());
+                wall_count = generate_random_walls(room, 0.2, random).placed;
             }
-
-            player.set_zoom_level(game_size.get_zoom_level());
-            player.update(game_timing.get_delta_time());
-            player.check_hitbox_collision(monster.get_hitbox());
-
-            monster.set_zoom_level(game_size.get_zoom_level());
-            monster.update(game_timing.get_delta_time(), room, player);
-            monster.check_hitbox_collision(player.get_hitbox());
-
-            // rebuilding the room to update the zoom level
-            room.set_zoom_level(game_size.get_zoom_level());
-            room.build_room();
-
-            // setting the camera position to the player's center position
-            coordinate center_pos = game_size.get_camera_position(player.get_center_position());
-            set_camera_position({center_pos.x, center_pos.y});
-
-            // drawing the room, npcs, player, and monster
-            room.draw();
-            for (int i = 0; i < npc_count; i++)
+            for (int y = 1; size == PILLAR_ROOM && y + 1 < 60; y += 3)
             {
-                // only draw the npc if it is on the screen
-                if (rect_on_screen(npcs[i]->get_hurtbox()))
+                for (int x = 1; x + 1 < 60; x += 3)
                 {
-                    npcs[i]->draw();
+                    // leaving the tiles around the spawn free
+                    coordinate spawn_tile = room.get_spawn_coords().pixel_to_tile(room.get_tile_size());
+                    if (std::abs(x - spawn_tile.x) > 3 || std::abs(y - spawn_tile.y) > 3)
+                    {
+                        room.set_wall({(double)x, (double)y}, {(double)x + 1, (double)y + 1});
+                        wall_count++;
+                    }
                 }
             }
-            // only draw the player if it is on the screen
-            if (rect_on_screen(player.get_hurtbox()))
-            {
-                player.draw();
-            }
-            // only draw the monster if it is on the screen
-            if (rect_on_screen(monster.get_hurtbox()))
-            {
-                monster.draw(highlight_ease, game_timing.get_time_difference());
-            }
-
-            // control functions for player and ability (focusing)
-            control_player(player, game_timing, room);
-            control_ability(game_timing, game_size, monster, time_rate_ease, zoom_level_ease, filter_ease);
+            player_data player(room.get_tile_size(), room.get_tile_size(), room.get_spawn_coords(), sprites.get(sprites.find("player_idle")), sprites.get(sprites.find("sword_1")), sprites.get(sprites.find("sword_2")));
 
-            // draw for the first 3 seconds of the game
-            if (timer_countdown(time_limit, timer_over) >= time_limit - 3000)
+            vector<vector_2d> directions;
+            for (int i = 0; i < 256; i++)
             {
-                // drawing the level text on the screen
-                draw_level_text(game_level, WINDOW_WIDTH, WINDOW_HEIGHT);
-                // drawing the control text on the screen
-                draw_control_text(WINDOW_WIDTH, WINDOW_HEIGHT);
+                directions.push_back({(double)random.next_int(-1, 2), (double)random.next_int(-1, 2)});
             }
+            double distance = player.get_speed() * TICK_TIME;
+
+            run_micro_benchmark("character_data::move", room_name + " walls=" + std::to_string(wall_count), min_time, [&](long long ops)
+                                {
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        vector_2d direction = directions[i & 255];
+                                        player.move(direction, distance, room);
+                                    } });
+        }
+    }
 
-            // drawing the timer countdown on the screen
-            draw_timer(timer_countdown(time_limit, timer_over) / 1000, WINDOW_WIDTH, WINDOW_HEIGHT);
-
-            // creating visual warnings as timer goes down
-            count_down_warning(timer_countdown(time_limit, timer_over), 30000, room, initial_color_array, timer_warning_ease, game_timing.get_time_difference());
-            // if one of the npcs is dead, the timer will run down to 0 instantly
+    // rebuilding the floor and every wall, across room sizes
+    if (selected("room_data::build_room"))
+    {
+        int sizes[] = {20, 40, 60, 120, 240};
+        for (int size : sizes)
+        {
+            random_stream_data random(1);
+            room_data room(size, size, SCREEN_WIDTH, SCREEN_HEIGHT);
+            generate_random_walls(room, 0.2, random);
+
+            run_micro_benchmark("room_data::build_room", "size=" + std::to_string(size), min_time, [&](long long ops)
+                                {
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        room.build_room();
+                                    } });
+        }
+    }
 
-            if (timer_countdown(time_limit, timer_over) <= 0)
-            {
-                timer_out(npcs, monster);
-            }
+    // making a room and generating its walls (build_wall runs for each wall that is set), across room sizes
+    if (selected("generate_random_walls"))
+    {
+        int sizes[] = {20, 40, 60, 120, 240, 1000};
+        for (int size : sizes)
+        {
+            random_stream_data random(1);
+            run_micro_benchmark("generate_random_walls", "size=" + std::to_string(size), min_time, [&](long long ops)
+                                {
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        room_data room(size, size, SCREEN_WIDTH, SCREEN_HEIGHT);
+                                        generate_random_walls(room, 0.2, random);
+                                    } });
+        }
+    }
 
-            if (player.get_health() <= 0)
-            {
-                game_lost = true;
-                break;
-            }
-            if (monster.get_health() <= 0)
+    // picking a random free position for the npcs' footprint in range, the way npc_store_data::set_new_destination does, in a sparse and a cramped room
+    if (selected("room_data::random_free_position"))
+    {
+        for (int cramped = 0; cramped <= 1; cramped++)
+        {
+            random_stream_data random(1);
+            room_data room(60, 60, SCREEN_WIDTH, SCREEN_HEIGHT);
+            // the cramped room is filled with 2x2 pillars, leaving 1 tile wide corridors
+            for (int y = 1; cramped && y + 1 < 60; y += 3)
             {
-                game_won = true;
-                break;
+                for (int x = 1; x + 1 < 60; x += 3)
+                {
+                    room.set_wall({(double)x, (double)y}, {(double)x + 1, (double)y + 1});
+                }
             }
-
-            // limit refresh screen for frame rate
-            if (game_timing.update_frame())
+            int free_tiles = 0;
+            for (int y = 0; y < 60; y++)
             {
-                refresh_screen();
+                for (int x = 0; x < 60; x++)
+                {
+                    free_tiles += room.is_passable(x, y) ? 1 : 0;
+                }
             }
-
-            process_events();
+            int range = 10; // tiles, the npcs' auto_move_max_distance
+
+            // the npcs' footprint, worked out from their sprite the same way npc_store_data does
+            const sprite_data &npc_model = sprites.get(sprites.find("npc_idle"));
+            double npc_scaling = npc_model.get_scaling(room.get_tile_size());
+            int footprint_width = (int)ceil(npc_model.width * npc_scaling / room.get_tile_size());
+            int footprint_height = (int)ceil(npc_model.height * npc_scaling / room.get_tile_size());
+
+            run_micro_benchmark("room_data::random_free_position", string(cramped ? "cramped" : "sparse") + " free_tiles=" + std::to_string(free_tiles) + " footprint=" + std::to_string(footprint_width) + "x" + std::to_string(footprint_height), min_time, [&](long long ops)
+                                {
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        coordinate center = {(double)random.next_int(60), (double)random.next_int(60)};
+                                        coordinate result;
+                                        room.random_free_position(footprint_width, footprint_height, {center.x - range, center.y - range}, {center.x + range, center.y + range}, result, random);
+                                    } });
         }
+    }
 
-        for (int i = 0; i < npc_count; i++)
+    // drawing bounded ints from a stream, small bounds and a bound just past 2^30 where most draws would be biased without the rejection
+    if (selected("random_stream_data::next_int"))
+    {
+        int bounds[] = {2, 60, 1000, (1 << 30) + 1};
+        for (int bound : bounds)
         {
-            delete npcs[i];
+            random_stream_data random(1);
+            volatile int sink = 0; // keeps the draws from being optimized away
+            run_micro_benchmark("random_stream_data::next_int", "bound=" + std::to_string(bound), min_time, [&](long long ops)
+                                {
+                                    int total = 0;
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        total += random.next_int(bound);
+                                    }
+                                    sink = sink + total; });
         }
-        npcs.clear();
+    }
 
-        if (game_won)
+    // updating a scheduler of 1024 tweens with all of them moving (on the curve and on a lookup table of it), and with all of them at rest, each op is one update
+    if (selected("tween_scheduler_data::update"))
+    {
+        const int TWEEN_COUNT = 1024;
+        tween_scheduler_data tweens;
+        basic_tween_scheduler_data<ease_table_data<ease_out_quint_curve, 256>> table_tweens;
+        for (int i = 0; i < TWEEN_COUNT; i++)
         {
-            game_level++;
-            draw_end_screen("Level Complete!", "Press Esc to continue", rgba_color(255.0, 255.0, 255.0, 0.5), WINDOW_WIDTH, WINDOW_HEIGHT);
+            tweens.add(0);
+            table_tweens.add(0);
         }
 
-        if (game_lost)
+        run_micro_benchmark("tween_scheduler_data::update", "1024 moving (table 256)", min_time, [&](long long ops)
+                            {
+                                for (long long i = 0; i < ops; i++)
+                                {
+                                    if (i % 32 == 0)
+                                    {
+                                        for (int j = 0; j < TWEEN_COUNT; j++)
+                                        {
+                                            table_tweens.ease_to(j, (i / 32) % 2);
+                                        }
+                                    }
+                                    table_tweens.update(TICK_TIME);
+                                } });
+        run_micro_benchmark("tween_scheduler_data::update", "1024 moving", min_time, [&](long long ops)
+                            {
+                                for (long long i = 0; i < ops; i++)
+                                {
+                                    // new targets every 32 updates, before any tween reaches its target
+                                    if (i % 32 == 0)
+                                    {
+                                        for (int j = 0; j < TWEEN_COUNT; j++)
+                                        {
+                                            tweens.ease_to(j, (i / 32) % 2);
+                                        }
+                                    }
+                                    tweens.update(TICK_TIME);
+                                } });
+
+        for (int i = 0; i < TWEEN_COUNT; i++)
         {
-            game_level = 1;
-            draw_end_screen("Game Over!", "Press Esc to restart", rgba_color(139.0, 0.0, 0.0, 0.5), WINDOW_WIDTH, WINDOW_HEIGHT);
+            tweens.set_value(i, 0);
         }
+        run_micro_benchmark("tween_scheduler_data::update", "1024 at rest", min_time, [&](long long ops)
+                            {
+                                for (long long i = 0; i < ops; i++)
+                                {
+                                    tweens.update(TICK_TIME);
+                                } });
+    }
 
-        refresh_screen();
-
-        while (!quit_requested() && !key_typed(ESCAPE_KEY))
+    // a whole headless update with n npcs, a new level is made whenever one ends (making it is not timed)
+    if (selected("headless frame"))
+    {
+        int npc_counts[] = {10, 100, 1000, 10000};
+        job_system_data job_system;
+        for (int npc_count : npc_counts)
         {
-            process_events();
+            random_stream_data random(1);
+            scripted_input_data input(random.next());
+            std::unique_ptr<level_data> level;
+            benchmark_untimed_data untimed = {0, 0};
+
+            run_micro_benchmark("headless frame", "npcs=" + std::to_string(npc_count), min_time, [&](long long ops)
+                                {
+                                    for (long long i = 0; i < ops; i++)
+                                    {
+                                        if (!level || level->is_over())
+                                        {
+                                            // npcs = level + 1
+                                            untimed.run([&]
+                                                        { level.reset(new level_data(npc_count - 1, SCREEN_WIDTH, SCREEN_HEIGHT, 60, 60, TICK_RATE, HUGE_VAL, sprites, random.next())); });
+                                        }
+                                        level->update_tick(input.update(TICK_TIME), &job_system);
+                                    } }, &untimed);
         }
-
-        reset_timer("Main timer");
-        process_events();
     }
     return 0;
 }
+#endif
+
+// a seed for a new game, different every time the game is played
+unsigned long long new_game_seed()
+{
+    return ((unsigned long long)std::random_device()() << 32) ^ (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// run with --headless [ticks] [seed] to run the simulation without a window,
+// or --benchmark [seconds] [seed] to run the game in a window as fast as it can go, otherwise the game is played in a window
+// the game is a new one every time it is played, unless it is run with --seed [seed]
+// --record [file] [seed] plays the game and saves a replay, --replay [file] plays it again headless and --replay-window [file] in a window
+// builds with -DFTF_BENCHMARK also have --micro-benchmark [filter] [seconds per benchmark]
+int main(int argc, char *argv[])
+{
+    string mode = argc > 1 ? string(argv[1]) : "";
+    if (mode == "--headless")
+    {
+        int tick_count = argc > 2 ? std::atoi(argv[2]) : 100000;
+        unsigned long long seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+        return run_headless(tick_count, seed);
+    }
+    if (mode == "--check")
+    {
+        return run_checks();
+    }
+    if (mode == "--benchmark")
+    {
+        double seconds = argc > 2 ? std::atof(argv[2]) : 10;
+        unsigned long long seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 1;
+        return run_benchmark(seconds, seed);
+    }
+#ifdef FTF_BENCHMARK
+    if (mode == "--micro-benchmark")
+    {
+        string filter = argc > 2 ? string(argv[2]) : "";
+        double min_time = argc > 3 ? std::atof(argv[3]) : 0.25;
+        return run_micro_benchmarks(filter, min_time);
+    }
+#endif
+    if (mode == "--generate-room")
+    {
+        int size = argc > 2 ? std::atoi(argv[2]) : 1000;
+        double density = argc > 3 ? std::atof(argv[3]) : 0.2;
+        unsigned long long seed = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 1;
+        return run_room_generator(size, density, seed);
+    }
+    if (mode == "--pack-sprites")
+    {
+        return run_sprite_packer(argc > 2 ? string(argv[2]) : "./image_data");
+    }
+    if (mode == "--record" && argc > 2)
+    {
+        unsigned long long seed = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : new_game_seed();
+        return run_game(seed, argv[2]);
+    }
+    if ((mode == "--replay" || mode == "--replay-window") && argc > 2)
+    {
+        return run_replay(argv[2], mode == "--replay-window");
+    }
+    if (mode == "--seed" && argc > 2)
+    {
+        return run_game(std::strtoull(argv[2], nullptr, 10));
+    }
+    return run_game(new_game_seed());
+}